@@ -0,0 +1,401 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "board.hpp"
+#include "endgame.hpp"
+#include "eval.hpp"
+#include "search.hpp"
+#include "stats.hpp"
+
+using namespace std;
+
+/*
+ * Analyses a file of positions in parallel and labels each one.
+ *
+ *   analyze [input] [-o output] [-d depth | -m ms | -x | -e] [-t threads]
+ *           [-h tt-megabytes]
+ *
+ * Each input line is a position in the format calibrate reads:
+ *
+ *   <64 squares, row by row: 'b', 'w', anything else empty> <b|w>
+ *
+ * and anything after the side to move is ignored. The input ("-" or no
+ * argument for stdin) is streamed, so it can be any length. Positions are
+ * searched to a fixed depth (-d, the default), for a fixed time (-m),
+ * solved exactly (-x), or looked at one ply deep with the static evaluation
+ * (-e), and every line of the output is
+ *
+ *   <squares> <b|w> <move> <score> <depth> <nodes>
+ *
+ * in input order. move is a square ("d3") or "pass"; score is in discs for
+ * the side to move, exact for solved and finished positions (a search that
+ * proves a win or loss stops there and reports the margin of the line it
+ * found); depth is the last completed iteration, or the empties when
+ * solved. With -e a worker takes EVAL_BATCH_POSITIONS positions at a time
+ * and scores the replies to all of them with a single evalBatch call. A
+ * side that must pass is labelled from the opponent's search. A line that
+ * is not a position comes out as itself followed by "error".
+ *
+ * Every thread has its own table of the given size (the endgame cache when
+ * solving). Fixed-depth labels don't depend on the thread count or on the
+ * order positions were taken in.
+ */
+
+// Positions read ahead of the oldest one not yet written, per thread.
+static const size_t WINDOW_PER_THREAD = 64;
+static const int UNLIMITED_MS = -1;
+// Positions an evaluating worker (-e) takes at a time.
+static const size_t EVAL_BATCH_POSITIONS = 32;
+
+enum Mode {
+    MODE_DEPTH, MODE_TIME, MODE_EXACT, MODE_EVAL
+};
+
+struct Job {
+    string line;
+    bool valid;
+    Board board;
+    Side toMove;
+
+    bool done;
+    int move;
+    double score;
+    int depth;
+    uint64_t nodes;
+};
+
+static Mode mode = MODE_DEPTH;
+static int depth = 12;
+static int msPerPosition = 1000;
+static size_t ttMegabytes = 16;
+
+// The window of jobs between the oldest unwritten one and the newest read,
+// job n in slot n % window. All of it is guarded by jobLock.
+static vector<Job> jobs;
+static size_t window;
+static size_t numRead = 0;
+static size_t numTaken = 0;
+static size_t numWritten = 0;
+static bool endOfInput = false;
+static mutex jobLock;
+static condition_variable workReady;
+static condition_variable spaceReady;
+static FILE *output;
+
+static bool parsePosition(const char *line, Job *job) {
+    if (strlen(line) < 66 || line[64] != ' ') return false;
+    if (line[65] != 'b' && line[65] != 'w') return false;
+
+    char data[64];
+    for (int i = 0; i < 64; i++) {
+        data[i] = (line[i] == 'b' || line[i] == 'w') ? line[i] : ' ';
+    }
+    job->board.setBoard(data);
+    job->toMove = (line[65] == 'b') ? BLACK : WHITE;
+    return true;
+}
+
+/*
+ * Disc differential for side of a finished game, empties to the winner.
+ */
+static int finishedScore(const Board &board, Side side) {
+    int diff = popCount(board.getPieces(side)) -
+               popCount(board.getPieces(opponent(side)));
+    int empties = 64 - popCount(board.getTaken());
+    if (diff > 0) return diff + empties;
+    if (diff < 0) return diff - empties;
+    return 0;
+}
+
+/*
+ * A search score in discs; finished games carry their exact differential.
+ */
+static double searchScore(int score) {
+    if (score >= SCORE_WIN) return score - SCORE_WIN;
+    if (score <= -SCORE_WIN) return score + SCORE_WIN;
+    return (double)score / EVAL_SCALE;
+}
+
+/*
+ * Labels one position for `side`, which must have a move.
+ */
+static void analyse(TranspositionTable &table, Endgame &endgame,
+                    const Board &board, Side side, Job *job) {
+    if (mode == MODE_EXACT) {
+        job->move = endgame.solve(board, side, UNLIMITED_MS);
+        job->score = endgame.getScore();
+        job->depth = 64 - popCount(board.getTaken());
+        job->nodes = endgame.getNodes();
+        return;
+    }
+
+    // A fresh search and table, so that the label doesn't depend on what
+    // the thread searched before.
+    table.clear();
+    Search search;
+    search.setTable(&table);
+    if (mode == MODE_TIME) {
+        job->move = search.run(board, side, SEARCH_MAX_DEPTH, msPerPosition);
+    } else {
+        job->move = search.run(board, side, depth, UNLIMITED_MS);
+    }
+    job->score = searchScore(search.getScore());
+    job->depth = search.getDepth();
+    job->nodes = search.getNodes();
+}
+
+static void label(TranspositionTable &table, Endgame &endgame, Job *job) {
+    Side side = job->toMove;
+    if (job->board.generateMoves(side) != 0) {
+        analyse(table, endgame, job->board, side, job);
+        return;
+    }
+
+    job->move = STATS_PASS;
+    if (job->board.generateMoves(opponent(side)) == 0) {
+        job->score = finishedScore(job->board, side);
+        job->depth = 0;
+        job->nodes = 0;
+        return;
+    }
+    analyse(table, endgame, job->board, opponent(side), job);
+    job->move = STATS_PASS;
+    job->score = -job->score;
+}
+
+/*
+ * Labels `count` jobs from `first` on at one ply: every reply is scored by
+ * the evaluation, all of them in one batch, or exactly if it ends the game.
+ */
+static void evaluate(size_t first, size_t count) {
+    vector<uint64_t> black, white;
+    vector<Side> toMove;
+    // Squares played and the job they belong to, per reply evaluated.
+    vector<int> moveOf;
+    vector<size_t> jobOf;
+
+    for (size_t n = first; n < first + count; n++) {
+        Job *job = &jobs[n % window];
+        if (!job->valid) continue;
+        job->move = STATS_PASS;
+        job->depth = 1;
+        job->nodes = 0;
+
+        Side side = job->toMove;
+        uint64_t moves = job->board.generateMoves(side);
+        if (moves == 0) {
+            side = opponent(side);
+            moves = job->board.generateMoves(side);
+        }
+        if (moves == 0) {
+            job->score = finishedScore(job->board, job->toMove);
+            job->depth = 0;
+            continue;
+        }
+
+        int best = -2 * SCORE_WIN;
+        while (moves) {
+            int sq = __builtin_ctzll(moves);
+            moves &= moves - 1;
+            Board child = job->board;
+            child.makeMove(sq, side);
+            job->nodes++;
+            if ((child.generateMoves(BLACK) |
+                 child.generateMoves(WHITE)) == 0) {
+                int score = finishedScore(child, side);
+                score += (score > 0) ? SCORE_WIN : (score < 0) ? -SCORE_WIN : 0;
+                if (score > best) {
+                    best = score;
+                    job->move = sq;
+                }
+                continue;
+            }
+            black.push_back(child.getPieces(BLACK));
+            white.push_back(child.getPieces(WHITE));
+            toMove.push_back(opponent(side));
+            moveOf.push_back(sq);
+            jobOf.push_back(n);
+        }
+        // Finished replies are settled already; the rest are compared below.
+        job->score = best;
+    }
+
+    vector<int> scores(black.size());
+    evalBatch(black.data(), white.data(), toMove.data(), (int)black.size(),
+              scores.data());
+    for (size_t i = 0; i < scores.size(); i++) {
+        Job *job = &jobs[jobOf[i] % window];
+        if (-scores[i] > job->score) {
+            job->score = -scores[i];
+            job->move = moveOf[i];
+        }
+    }
+
+    for (size_t n = first; n < first + count; n++) {
+        Job *job = &jobs[n % window];
+        if (!job->valid || job->depth == 0) continue;
+        job->score = searchScore((int)job->score);
+        if (job->board.generateMoves(job->toMove) == 0) {
+            // Labelled from the opponent's point of view, as label() does.
+            job->move = STATS_PASS;
+            job->score = -job->score;
+        }
+    }
+}
+
+/*
+ * Writes every finished job at the front of the window. Called with jobLock
+ * held.
+ */
+static void writeFinished() {
+    size_t before = numWritten;
+    while (numWritten < numTaken && jobs[numWritten % window].done) {
+        const Job &job = jobs[numWritten % window];
+        if (!job.valid) {
+            fprintf(output, "%s error\n", job.line.c_str());
+        } else {
+            char name[8];
+            squareName(job.move, name);
+            fprintf(output, "%.66s %s %.2f %d %llu\n", job.line.c_str(),
+                    name, job.score, job.depth, (unsigned long long)job.nodes);
+        }
+        numWritten++;
+    }
+    if (numWritten != before) spaceReady.notify_one();
+}
+
+/*
+ * Takes positions in input order until the input runs out.
+ */
+static void worker() {
+    TranspositionTable table(ttMegabytes);
+    // Only exact solving uses the endgame cache.
+    Endgame endgame((mode == MODE_EXACT) ? ttMegabytes : 1);
+
+    size_t batch = (mode == MODE_EVAL) ? EVAL_BATCH_POSITIONS : 1;
+    unique_lock<mutex> guard(jobLock);
+    while (true) {
+        while (numRead - numTaken < batch && !endOfInput) workReady.wait(guard);
+        if (numTaken == numRead) break;
+
+        size_t first = numTaken;
+        size_t count = min(batch, numRead - numTaken);
+        numTaken += count;
+        guard.unlock();
+        if (mode == MODE_EVAL) {
+            evaluate(first, count);
+        } else {
+            Job *job = &jobs[first % window];
+            if (job->valid) label(table, endgame, job);
+        }
+        guard.lock();
+
+        for (size_t n = first; n < first + count; n++) {
+            jobs[n % window].done = true;
+        }
+        writeFinished();
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [input] [-o output] "
+                    "[-d depth | -m ms | -x | -e] [-t threads] "
+                    "[-h tt-megabytes]\n", name);
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *inputPath = "-";
+    const char *outputPath = "-";
+    int threads = thread::hardware_concurrency();
+
+    int i = 1;
+    if (i < argc && (argv[i][0] != '-' || !strcmp(argv[i], "-"))) {
+        inputPath = argv[i++];
+    }
+    for (; i < argc; i++) {
+        if (!strcmp(argv[i], "-x")) {
+            mode = MODE_EXACT;
+            continue;
+        }
+        if (!strcmp(argv[i], "-e")) {
+            mode = MODE_EVAL;
+            continue;
+        }
+        if (i + 1 >= argc) usage(argv[0]);
+        if (!strcmp(argv[i], "-o")) outputPath = argv[++i];
+        else if (!strcmp(argv[i], "-d")) {
+            mode = MODE_DEPTH;
+            depth = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-m")) {
+            mode = MODE_TIME;
+            msPerPosition = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-t")) threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-h")) ttMegabytes = atoi(argv[++i]);
+        else usage(argv[0]);
+    }
+    if (threads < 1) threads = 1;
+    if (depth < 1) depth = 1;
+    if (msPerPosition < 1) msPerPosition = 1;
+    if (ttMegabytes < 1) ttMegabytes = 1;
+
+    FILE *input = strcmp(inputPath, "-") ? fopen(inputPath, "r") : stdin;
+    if (input == nullptr) {
+        fprintf(stderr, "can't open %s\n", inputPath);
+        return 1;
+    }
+    output = strcmp(outputPath, "-") ? fopen(outputPath, "w") : stdout;
+    if (output == nullptr) {
+        fprintf(stderr, "can't write %s\n", outputPath);
+        return 1;
+    }
+
+    // Labels with the weights the engine would load.
+    evalInit();
+
+    window = WINDOW_PER_THREAD * threads;
+    jobs.resize(window);
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread(worker));
+    }
+
+    // Whole lines, however long, so that output lines match input lines.
+    char *line = nullptr;
+    size_t capacity = 0;
+    while (getline(&line, &capacity, input) >= 0) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        unique_lock<mutex> guard(jobLock);
+        while (numRead - numWritten == window) spaceReady.wait(guard);
+        Job *job = &jobs[numRead % window];
+        job->line = line;
+        job->valid = parsePosition(line, job);
+        job->done = false;
+        numRead++;
+        workReady.notify_one();
+    }
+    {
+        lock_guard<mutex> guard(jobLock);
+        endOfInput = true;
+    }
+    workReady.notify_all();
+    free(line);
+
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+    if (input != stdin) fclose(input);
+    if (output != stdout && fclose(output) != 0) {
+        fprintf(stderr, "can't write %s\n", outputPath);
+        return 1;
+    }
+    fprintf(stderr, "analysed %zu positions\n", numWritten);
+    return 0;
+}
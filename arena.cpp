@@ -0,0 +1,323 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "player.hpp"
+#include "gamedb.hpp"
+
+using namespace std;
+
+/*
+ * Plays matches between two Player configurations without the Java
+ * framework. Every opening is played twice with colors swapped, games run in
+ * parallel, and the result is reported as a score, an Elo difference with a
+ * 95% error bar, and each engine's search speed.
+ *
+ *   arena [-a engine] [-b engine] [-n openings] [-p plies] [-m ms]
+ *         [-t threads] [-h tt-megabytes] [-s seed] [-g game-file]
+ *
+ * An engine is random, heuristic, minimax, flat, alphabeta or exact (alpha-beta
+ * without ProbCut pruning), optionally followed by ":depth" to cap the
+ * alpha-beta depth. With -g every game, opening included, is appended to a
+ * game file (gamedb.hpp).
+ */
+
+struct Engine {
+    const char *spec;
+    AI_t type;
+    int depth;
+    bool selective;
+};
+
+struct Opening {
+    Board board;
+    Side toMove;
+    // The moves from the start that lead to board.
+    MoveList moves;
+};
+
+/*
+ * Totals for one engine; updated under resultLock.
+ */
+struct EngineStats {
+    double points;
+    int wins, draws, losses, timeouts;
+    uint64_t nodes;
+    double seconds;
+};
+
+static const char *ENGINE_NAMES[] = {
+    "random", "heuristic", "minimax", "flat", "alphabeta", "exact"
+};
+static const AI_t ENGINE_TYPES[] = {
+    RANDOM_AI, HEURISTIC_AI, MINIMAX_AI, FLAT_AI, ALPHABETA_AI, ALPHABETA_AI
+};
+static const int NUM_ENGINES = sizeof(ENGINE_NAMES) / sizeof(ENGINE_NAMES[0]);
+
+static Engine engines[2];
+static vector<Opening> openings;
+static int msPerGame = 10000;
+static size_t ttMegabytes = 16;
+// Where games are recorded, if it is open.
+static GameWriter gameFile;
+
+static atomic<int> nextGame(0);
+static mutex resultLock;
+static EngineStats stats[2];
+// Points engine A scored in each game, for the error bar.
+static vector<double> gameScores;
+
+static bool parseEngine(const char *spec, Engine *engine) {
+    engine->spec = spec;
+    engine->depth = SEARCH_MAX_DEPTH;
+
+    const char *colon = strchr(spec, ':');
+    size_t length = colon ? (size_t)(colon - spec) : strlen(spec);
+    if (colon) engine->depth = atoi(colon + 1);
+
+    for (int i = 0; i < NUM_ENGINES; i++) {
+        if (strlen(ENGINE_NAMES[i]) == length &&
+            !strncmp(spec, ENGINE_NAMES[i], length)) {
+            engine->type = ENGINE_TYPES[i];
+            engine->selective = strcmp(ENGINE_NAMES[i], "exact") != 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Random but reproducible openings of the given length, without repeats.
+ */
+static void makeOpenings(int count, int plies, unsigned seed) {
+    srand(seed);
+    vector<uint64_t> seen;
+    int attempts = 0;
+
+    while ((int)openings.size() < count && attempts++ < count * 100) {
+        Opening opening;
+        opening.toMove = BLACK;
+        bool ok = true;
+        for (int ply = 0; ply < plies && ok; ply++) {
+            uint64_t moves = opening.board.generateMoves(opening.toMove);
+            if (moves == 0) {
+                ok = false;
+                break;
+            }
+            for (int k = rand() % popCount(moves); k > 0; k--) {
+                moves &= moves - 1;
+            }
+            opening.board.makeMove(firstSquare(moves), opening.toMove);
+            opening.moves.push(firstSquare(moves));
+            opening.toMove = opponent(opening.toMove);
+        }
+
+        uint64_t key = opening.board.getHash(opening.toMove);
+        for (int i = 0; i < (int)seen.size() && ok; i++) {
+            if (seen[i] == key) ok = false;
+        }
+        if (!ok) continue;
+
+        seen.push_back(key);
+        openings.push_back(opening);
+    }
+}
+
+static Player *makePlayer(const Engine &engine, Side side, const Board &start) {
+    Player *player = new Player(side, new Board(start), ttMegabytes);
+    player->AI_type = engine.type;
+    player->max_depth = engine.depth;
+    player->selective = engine.selective;
+    return player;
+}
+
+/*
+ * Plays one game; engine A has black when aBlack is set. Records the
+ * result and both engines' statistics.
+ */
+static void playGame(const Opening &opening, bool aBlack) {
+    Player *players[2];
+    int engineOf[2];
+    engineOf[BLACK] = aBlack ? 0 : 1;
+    engineOf[WHITE] = aBlack ? 1 : 0;
+    players[BLACK] = makePlayer(engines[engineOf[BLACK]], BLACK, opening.board);
+    players[WHITE] = makePlayer(engines[engineOf[WHITE]], WHITE, opening.board);
+
+    Board board = opening.board;
+    Side side = opening.toMove;
+    Move *last = nullptr;
+    int msLeft[2] = {msPerGame, msPerGame};
+    double seconds[2] = {0, 0};
+    int passes = 0;
+    int timedOut = -1;
+
+    GameRecord record;
+    gameClear(&record);
+    for (int i = 0; i < opening.moves.size; i++) {
+        gamePush(&record, opening.moves[i]);
+    }
+
+    while (passes < 2) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        Move *move = players[side]->doMove(last, msLeft[side]);
+        double elapsed = chrono::duration<double>(
+            chrono::steady_clock::now() - start).count();
+        seconds[side] += elapsed;
+        msLeft[side] -= (int)(elapsed * 1000);
+
+        // The move belongs to the player, which keeps it until its next
+        // turn, after the opponent has seen it.
+        last = move;
+        if (msLeft[side] < 0 || !board.checkMove(move, side)) {
+            // Out of time, or an illegal move: forfeit like the framework.
+            timedOut = side;
+            break;
+        }
+
+        if (move != nullptr) {
+            board.doMove(move, side);
+            gamePush(&record, move->x + NUM_OTHELLO_SQUARES * move->y);
+            passes = 0;
+        } else {
+            passes++;
+        }
+        side = opponent(side);
+    }
+
+    // Points for black.
+    double blackPoints;
+    if (timedOut >= 0) {
+        blackPoints = (timedOut == BLACK) ? 0 : 1;
+    } else {
+        int diff = board.countBlack() - board.countWhite();
+        blackPoints = (diff > 0) ? 1 : (diff < 0) ? 0 : 0.5;
+    }
+
+    if (gameFile.isOpen()) {
+        int flags = (timedOut == BLACK) ? GAME_BLACK_FORFEIT
+                  : (timedOut == WHITE) ? GAME_WHITE_FORFEIT : 0;
+        gameFinish(&record, board, flags);
+        gameFile.append(record);
+    }
+
+    lock_guard<mutex> lock(resultLock);
+    for (int s = WHITE; s <= BLACK; s++) {
+        EngineStats &e = stats[engineOf[s]];
+        double points = (s == BLACK) ? blackPoints : 1 - blackPoints;
+        e.points += points;
+        if (points == 1) e.wins++;
+        else if (points == 0) e.losses++;
+        else e.draws++;
+        if (timedOut == s) e.timeouts++;
+        e.nodes += players[s]->getNodes();
+        e.seconds += seconds[s];
+    }
+    gameScores.push_back(aBlack ? blackPoints : 1 - blackPoints);
+
+    delete players[BLACK];
+    delete players[WHITE];
+}
+
+static void worker() {
+    int total = 2 * openings.size();
+    for (int game = nextGame++; game < total; game = nextGame++) {
+        playGame(openings[game / 2], game % 2 == 0);
+    }
+}
+
+static double elo(double score) {
+    if (score <= 0) return -INFINITY;
+    if (score >= 1) return INFINITY;
+    return -400 * log10(1 / score - 1);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-a engine] [-b engine] [-n openings] "
+                    "[-p plies] [-m ms] [-t threads] [-h tt-megabytes] "
+                    "[-s seed] [-g game-file]\n", name);
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *specs[2] = {"alphabeta", "heuristic"};
+    int numOpenings = 50;
+    int plies = 6;
+    int threads = thread::hardware_concurrency();
+    unsigned seed = 1;
+    const char *gamePath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) usage(argv[0]);
+        if (!strcmp(argv[i], "-a")) specs[0] = argv[++i];
+        else if (!strcmp(argv[i], "-b")) specs[1] = argv[++i];
+        else if (!strcmp(argv[i], "-n")) numOpenings = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-p")) plies = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-m")) msPerGame = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-t")) threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-h")) ttMegabytes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s")) seed = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-g")) gamePath = argv[++i];
+        else usage(argv[0]);
+    }
+    for (int e = 0; e < 2; e++) {
+        if (!parseEngine(specs[e], &engines[e])) {
+            fprintf(stderr, "unknown engine %s\n", specs[e]);
+            usage(argv[0]);
+        }
+    }
+    if (threads < 1) threads = 1;
+    if (gamePath != nullptr && !gameFile.open(gamePath)) {
+        fprintf(stderr, "can't write games to %s\n", gamePath);
+        return 1;
+    }
+
+    makeOpenings(numOpenings, plies, seed);
+    memset(stats, 0, sizeof(stats));
+
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread(worker));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+
+    int games = gameScores.size();
+    if (games == 0) {
+        fprintf(stderr, "no games played\n");
+        return 1;
+    }
+
+    // 95% interval of A's mean score, mapped to Elo.
+    double score = stats[0].points / games;
+    double variance = 0;
+    for (int i = 0; i < games; i++) {
+        variance += (gameScores[i] - score) * (gameScores[i] - score);
+    }
+    double margin = 1.96 * sqrt(variance / games / games);
+    double low = elo(score - margin), high = elo(score + margin);
+
+    printf("%d games from %d openings, %d ms per player per game\n",
+           games, (int)openings.size(), msPerGame);
+    for (int e = 0; e < 2; e++) {
+        EngineStats &s = stats[e];
+        printf("%c %-16s +%d =%d -%d  timeouts %d  nps %.0f\n", 'A' + e,
+               engines[e].spec, s.wins, s.draws, s.losses, s.timeouts,
+               (s.seconds > 0) ? s.nodes / s.seconds : 0.0);
+    }
+    if (score <= 0 || score >= 1) {
+        printf("score of A: %.1f%%, Elo difference unbounded\n", 100 * score);
+    } else if (isinf(low) || isinf(high)) {
+        printf("score of A: %.1f%%, Elo difference %+.1f +/- inf\n",
+               100 * score, elo(score));
+    } else {
+        printf("score of A: %.1f%%, Elo difference %+.1f +/- %.1f\n",
+               100 * score, elo(score), (high - low) / 2);
+    }
+    return 0;
+}
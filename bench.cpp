@@ -0,0 +1,378 @@
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+#include "player.hpp"
+
+using namespace std;
+
+/*
+ * Move-generation and search micro-benchmarks. Every result is printed as one
+ * JSON object per line on stdout so runs of different builds can be compared
+ * by a script; the exit status is non-zero if a perft count is wrong.
+ *
+ *   bench [-d perft-depth] [-s search-depth] [-e endgame-empties]
+ *         [-n eval-positions] [-q]
+ *
+ * perft counts the leaves of the game tree to a fixed depth, once with
+ * makeMove/unmakeMove and once with a board copy and doMove per move. A pass
+ * counts as a ply, and a finished game is a leaf wherever it occurs. The
+ * search benchmarks run every AI_t on fixed positions with a depth cap and no
+ * time limit and report nodes per second, and how many heap allocations the
+ * searches made (the operator new below counts them). The evaluation benchmarks score a
+ * set of random positions with evalBoard and with every batch kernel the CPU
+ * runs, and report evaluations per second.
+ */
+
+// Heap allocations made by the process so far.
+static atomic<uint64_t> allocations(0);
+
+void *operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr) throw bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+struct Position {
+    const char *name;
+    // One character per square x + 8*y: 'b', 'w' or '-'.
+    const char *squares;
+    Side toMove;
+};
+
+static const Position POSITIONS[] = {
+    {"start",
+     "---------------------------wb------bw---------------------------",
+     BLACK},
+    {"mid20",
+     "----------bbbbw-w-bbbb---w-wwb--b-wwbw-----bwww------w----------",
+     BLACK},
+    {"mid30",
+     "-b-w----w-bw----wwbb-w-ww-wbbww-bbbwbw--w-w-w-b--w-b-b-b--w-b-b-",
+     BLACK},
+    {"mid40",
+     "---w---w---www-wbbwb-wwwwwwwwbbw-bbwbbww--bbbbbw-w-bbww---bb-bww",
+     BLACK},
+};
+static const int NUM_POSITIONS = sizeof(POSITIONS) / sizeof(POSITIONS[0]);
+
+// Leaf counts from the standard starting position, depth 1 upwards.
+static const uint64_t START_PERFT[] = {
+    4, 12, 56, 244, 1396, 8200, 55092, 390216, 3005288, 24571284
+};
+static const int START_PERFT_DEPTH = sizeof(START_PERFT) / sizeof(START_PERFT[0]);
+
+static const char *ENGINE_NAMES[] = {
+    "random", "heuristic", "minimax", "flat", "alphabeta"
+};
+static const AI_t ENGINE_TYPES[] = {
+    RANDOM_AI, HEURISTIC_AI, MINIMAX_AI, FLAT_AI, ALPHABETA_AI
+};
+
+// Large enough that no time-based budget ever cuts a search short.
+static const int UNLIMITED_MS = INT_MAX / 2;
+
+static Board makeBoard(const Position &position) {
+    char data[64];
+    for (int sq = 0; sq < 64; sq++) {
+        char c = position.squares[sq];
+        data[sq] = (c == 'b') ? 'b' : (c == 'w') ? 'w' : ' ';
+    }
+    Board board;
+    board.setBoard(data);
+    return board;
+}
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * Leaf count with make/unmake on a single board.
+ */
+static uint64_t perft(Board &board, Side side, int depth, bool passed) {
+    if (depth == 0) return 1;
+
+    uint64_t moves = board.generateMoves(side);
+    if (moves == 0) {
+        if (passed) return 1;
+        return perft(board, opponent(side), depth - 1, true);
+    }
+    if (depth == 1) return popCount(moves);
+
+    uint64_t leaves = 0;
+    while (moves) {
+        int sq = firstSquare(moves);
+        moves &= moves - 1;
+        uint64_t flipped = board.makeMove(sq, side);
+        leaves += perft(board, opponent(side), depth - 1, false);
+        board.unmakeMove(sq, side, flipped);
+    }
+    return leaves;
+}
+
+/*
+ * Leaf count through the Move interface: a board copy and doMove per move.
+ */
+static uint64_t perftDoMove(Board &board, Side side, int depth,
+                             bool passed) {
+    if (depth == 0) return 1;
+
+    bool any = false;
+    uint64_t leaves = 0;
+    for (int y = 0; y < NUM_OTHELLO_SQUARES; y++) {
+        for (int x = 0; x < NUM_OTHELLO_SQUARES; x++) {
+            Move move(x, y);
+            if (!board.checkMove(&move, side)) continue;
+            any = true;
+            Board next = board;
+            next.doMove(&move, side);
+            leaves += perftDoMove(next, opponent(side), depth - 1, false);
+        }
+    }
+    if (!any) {
+        if (passed) return 1;
+        return perftDoMove(board, opponent(side), depth - 1, true);
+    }
+    return leaves;
+}
+
+/*
+ * Runs both perft variants on a position; returns false on a mismatch with
+ * the other variant or with the expected count (0 if unknown).
+ */
+static bool benchPerft(const Position &position, int depth, uint64_t expected) {
+    Board board = makeBoard(position);
+    bool ok = true;
+
+    for (int variant = 0; variant < 2; variant++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        uint64_t leaves = (variant == 0)
+            ? perft(board, position.toMove, depth, false)
+            : perftDoMove(board, position.toMove, depth, false);
+        double seconds = secondsSince(start);
+
+        if (expected == 0) expected = leaves;
+        bool match = (leaves == expected);
+        ok = ok && match;
+        printf("{\"bench\":\"%s\",\"position\":\"%s\",\"depth\":%d,"
+               "\"leaves\":%llu,\"ms\":%.1f,\"lps\":%.0f,\"ok\":%s}\n",
+               (variant == 0) ? "perft" : "perft-domove", position.name,
+               depth, (unsigned long long)leaves, seconds * 1000,
+               (seconds > 0) ? leaves / seconds : 0.0,
+               match ? "true" : "false");
+        fflush(stdout);
+    }
+    return ok;
+}
+
+/*
+ * Asks a fresh player of the given type for one move in every midgame
+ * position and reports its combined speed.
+ */
+static void benchEngine(int engine, int depth) {
+    uint64_t nodes = 0, cutoffs = 0, firstCutoffs = 0, allocs = 0;
+    double seconds = 0;
+
+    for (int p = 1; p < NUM_POSITIONS; p++) {
+        Player player(POSITIONS[p].toMove, new Board(makeBoard(POSITIONS[p])));
+        player.AI_type = ENGINE_TYPES[engine];
+        player.max_depth = depth;
+        player.endgame_empties = 0;
+        player.use_book = false;
+        srand(1);
+
+        uint64_t before = allocations.load();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        player.doMove(nullptr, UNLIMITED_MS);
+        seconds += secondsSince(start);
+        allocs += allocations.load() - before;
+        nodes += player.getNodes();
+        cutoffs += player.getCutoffs();
+        firstCutoffs += player.getFirstCutoffs();
+    }
+
+    printf("{\"bench\":\"search\",\"engine\":\"%s\",\"depth\":%d,"
+           "\"positions\":%d,\"nodes\":%llu,\"ms\":%.1f,\"nps\":%.0f,"
+           "\"cutoffs\":%llu,\"first_cutoff_rate\":%.3f,\"allocs\":%llu}\n",
+           ENGINE_NAMES[engine], depth, NUM_POSITIONS - 1,
+           (unsigned long long)nodes, seconds * 1000,
+           (seconds > 0) ? nodes / seconds : 0.0,
+           (unsigned long long)cutoffs,
+           (cutoffs > 0) ? (double)firstCutoffs / cutoffs : 0.0,
+           (unsigned long long)allocs);
+    fflush(stdout);
+}
+
+/*
+ * Exact solves of every midgame position played out to the given number of
+ * empty squares.
+ */
+static void benchEndgame(int empties) {
+    Endgame endgame(DEFAULT_ENDGAME_CACHE_MB);
+    uint64_t nodes = 0, allocs = 0;
+    double seconds = 0;
+    int solved = 0;
+
+    for (int p = 1; p < NUM_POSITIONS; p++) {
+        // Fill the board deterministically: always the first legal move.
+        Board board = makeBoard(POSITIONS[p]);
+        Side side = POSITIONS[p].toMove;
+        int passes = 0;
+        while (64 - popCount(board.getTaken()) > empties && passes < 2) {
+            uint64_t moves = board.generateMoves(side);
+            if (moves) {
+                board.makeMove(firstSquare(moves), side);
+                passes = 0;
+            } else {
+                passes++;
+            }
+            side = opponent(side);
+        }
+        if (passes == 2) continue;
+
+        uint64_t before = allocations.load();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        endgame.solve(board, side, -1);
+        seconds += secondsSince(start);
+        allocs += allocations.load() - before;
+        nodes += endgame.getNodes();
+        solved++;
+    }
+
+    printf("{\"bench\":\"endgame\",\"empties\":%d,\"positions\":%d,"
+           "\"nodes\":%llu,\"ms\":%.1f,\"nps\":%.0f,\"allocs\":%llu}\n",
+           empties, solved, (unsigned long long)nodes, seconds * 1000,
+           (seconds > 0) ? nodes / seconds : 0.0, (unsigned long long)allocs);
+    fflush(stdout);
+}
+
+/*
+ * Scores `count` positions from random games with evalBoard, then with each
+ * batch kernel; a kernel is ok if it matches evalBoard on every position.
+ */
+static void benchEval(int count) {
+    vector<uint64_t> black, white;
+    vector<Side> toMove;
+    srand(1);
+    while ((int)black.size() < count) {
+        Board board;
+        Side side = BLACK;
+        int passes = 0;
+        while (passes < 2 && (int)black.size() < count) {
+            uint64_t moves = board.generateMoves(side);
+            if (moves) {
+                for (int skip = rand() % popCount(moves); skip > 0; skip--) {
+                    moves &= moves - 1;
+                }
+                board.makeMove(firstSquare(moves), side);
+                passes = 0;
+            } else {
+                passes++;
+            }
+            side = opponent(side);
+            black.push_back(board.getPieces(BLACK));
+            white.push_back(board.getPieces(WHITE));
+            toMove.push_back(side);
+        }
+    }
+
+    evalInit();
+    vector<int> expected(count);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        Board board;
+        board.setPieces(black[i], white[i]);
+        expected[i] = evalBoard(board, toMove[i]);
+    }
+    double seconds = secondsSince(start);
+    printf("{\"bench\":\"eval\",\"kernel\":\"board\",\"positions\":%d,"
+           "\"ms\":%.1f,\"eps\":%.0f,\"ok\":true}\n",
+           count, seconds * 1000, (seconds > 0) ? count / seconds : 0.0);
+    fflush(stdout);
+
+    EvalKernel best = evalBatchKernel();
+    const EvalKernel kernels[] = {
+        EVAL_KERNEL_SCALAR, EVAL_KERNEL_SSE2, EVAL_KERNEL_AVX2
+    };
+    vector<int> scores(count);
+    for (int k = 0; k < 3; k++) {
+        if (!evalSetBatchKernel(kernels[k])) continue;
+        start = chrono::steady_clock::now();
+        evalBatch(black.data(), white.data(), toMove.data(), count,
+                  scores.data());
+        seconds = secondsSince(start);
+
+        bool match = (scores == expected);
+        printf("{\"bench\":\"eval\",\"kernel\":\"%s\",\"positions\":%d,"
+               "\"ms\":%.1f,\"eps\":%.0f,\"ok\":%s}\n",
+               evalKernelName(kernels[k]), count, seconds * 1000,
+               (seconds > 0) ? count / seconds : 0.0,
+               match ? "true" : "false");
+        fflush(stdout);
+    }
+    evalSetBatchKernel(best);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-d perft-depth] [-s search-depth] "
+                    "[-e endgame-empties] [-n eval-positions] [-q]\n",
+            name);
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    int perftDepth = 8;
+    int searchDepth = 8;
+    int endgameEmpties = 18;
+    int evalPositions = 1000000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-q")) {
+            perftDepth = 6;
+            searchDepth = 5;
+            endgameEmpties = 12;
+            evalPositions = 100000;
+            continue;
+        }
+        if (i + 1 >= argc) usage(argv[0]);
+        if (!strcmp(argv[i], "-d")) perftDepth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s")) searchDepth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-e")) endgameEmpties = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n")) evalPositions = atoi(argv[++i]);
+        else usage(argv[0]);
+    }
+    if (perftDepth < 1) perftDepth = 1;
+
+    bool ok = true;
+    for (int p = 0; p < NUM_POSITIONS; p++) {
+        // The start position has known counts; midgame positions only have
+        // to agree between the two variants. They branch far more, so they
+        // go two plies less deep.
+        int depth = perftDepth;
+        uint64_t expected = 0;
+        if (p == 0) {
+            if (depth <= START_PERFT_DEPTH) expected = START_PERFT[depth - 1];
+        } else if (depth > 2) {
+            depth -= 2;
+        }
+        ok = benchPerft(POSITIONS[p], depth, expected) && ok;
+    }
+
+    for (int e = 0; e < 5; e++) {
+        benchEngine(e, searchDepth);
+    }
+    benchEndgame(endgameEmpties);
+    if (evalPositions > 0) benchEval(evalPositions);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+#ifndef __BITBOARD_H__
+#define __BITBOARD_H__
+
+#include <cstdint>
+
+/*
+ * Raw 64-bit board primitives. Square (x, y) lives in bit x + 8*y, so a shift
+ * by +1 moves one column right and a shift by +8 moves one row down. Every
+ * direction that changes the column needs a mask to stop bits wrapping onto
+ * the neighbouring row.
+ */
+
+// Clears column x == 0 (the landing squares of an x + 1 shift).
+static constexpr uint64_t NOT_A_FILE = 0xfefefefefefefefeULL;
+// Clears column x == 7 (the landing squares of an x - 1 shift).
+static constexpr uint64_t NOT_H_FILE = 0x7f7f7f7f7f7f7f7fULL;
+static constexpr uint64_t ALL_SQUARES = 0xffffffffffffffffULL;
+
+/*
+ * Shifts a bitboard by S squares; positive S shifts towards higher indices.
+ */
+template <int S>
+static inline uint64_t shiftBits(uint64_t b) {
+    return (S > 0) ? (b << (S > 0 ? S : 0)) : (b >> (S < 0 ? -S : 0));
+}
+
+/*
+ * Kogge-Stone occluded fill: grows gen through pro in direction S, doubling
+ * the step each round. Seven squares is the longest run on an 8x8 board, so
+ * three rounds are enough.
+ */
+template <int S, uint64_t M>
+static inline uint64_t occludedFill(uint64_t gen, uint64_t pro) {
+    pro &= M;
+    gen |= pro & shiftBits<S>(gen);
+    pro &= shiftBits<S>(pro);
+    gen |= pro & shiftBits<2 * S>(gen);
+    pro &= shiftBits<2 * S>(pro);
+    gen |= pro & shiftBits<4 * S>(gen);
+    return gen;
+}
+
+/*
+ * Squares one step past a run of opponent discs that starts next to one of
+ * our discs, in direction S.
+ */
+template <int S, uint64_t M>
+static inline uint64_t movesInDirection(uint64_t own, uint64_t opp) {
+    return shiftBits<S>(occludedFill<S, M>(own, opp) & opp) & M;
+}
+
+/*
+ * Returns the mask of legal moves for the side owning `own`.
+ */
+static inline uint64_t legalMoves(uint64_t own, uint64_t opp) {
+    uint64_t moves = movesInDirection< 1, NOT_A_FILE>(own, opp)
+                   | movesInDirection<-1, NOT_H_FILE>(own, opp)
+                   | movesInDirection< 8, ALL_SQUARES>(own, opp)
+                   | movesInDirection<-8, ALL_SQUARES>(own, opp)
+                   | movesInDirection< 9, NOT_A_FILE>(own, opp)
+                   | movesInDirection<-9, NOT_H_FILE>(own, opp)
+                   | movesInDirection< 7, NOT_H_FILE>(own, opp)
+                   | movesInDirection<-7, NOT_A_FILE>(own, opp);
+    return moves & ~(own | opp);
+}
+
+/*
+ * Opponent discs flipped in direction S by playing the single bit `move`: the
+ * run of opponent discs next to it, kept only if one of our discs closes it.
+ */
+template <int S, uint64_t M>
+static inline uint64_t flipsInDirection(uint64_t move, uint64_t own,
+                                        uint64_t opp) {
+    uint64_t fill = occludedFill<S, M>(move, opp);
+    uint64_t run = fill & ~move;
+    uint64_t closed = shiftBits<S>(fill) & M & own;
+    return run & (0 - (uint64_t)(closed != 0));
+}
+
+/*
+ * Returns the discs flipped by the side owning `own` playing on square sq.
+ * The eight directions are independent, so they evaluate in parallel; the
+ * result is zero if the move is not legal.
+ */
+static inline uint64_t discFlips(int sq, uint64_t own, uint64_t opp) {
+    uint64_t move = 1ULL << sq;
+    return flipsInDirection< 1, NOT_A_FILE>(move, own, opp)
+         | flipsInDirection<-1, NOT_H_FILE>(move, own, opp)
+         | flipsInDirection< 8, ALL_SQUARES>(move, own, opp)
+         | flipsInDirection<-8, ALL_SQUARES>(move, own, opp)
+         | flipsInDirection< 9, NOT_A_FILE>(move, own, opp)
+         | flipsInDirection<-9, NOT_H_FILE>(move, own, opp)
+         | flipsInDirection< 7, NOT_H_FILE>(move, own, opp)
+         | flipsInDirection<-7, NOT_A_FILE>(move, own, opp);
+}
+
+static inline int popCount(uint64_t b) {
+    return __builtin_popcountll(b);
+}
+
+/*
+ * Index of the lowest set bit; b must be non-zero.
+ */
+static inline int firstSquare(uint64_t b) {
+    return __builtin_ctzll(b);
+}
+
+// The four 4x4 quadrants, indexed by quadrantOf(). They are the parity
+// regions: the side that moves last into a region usually gains from it.
+static constexpr uint64_t QUADRANT[4] = {
+    0x000000000f0f0f0fULL, 0x00000000f0f0f0f0ULL,
+    0x0f0f0f0f00000000ULL, 0xf0f0f0f000000000ULL
+};
+
+static inline int quadrantOf(int sq) {
+    return ((sq >> 4) & 2) | ((sq >> 2) & 1);
+}
+
+/*
+ * Union of the quadrants holding an odd number of empty squares.
+ */
+static inline uint64_t oddQuadrants(uint64_t empty) {
+    uint64_t odd = 0;
+    for (int q = 0; q < 4; q++) {
+        if (popCount(empty & QUADRANT[q]) & 1) odd |= QUADRANT[q];
+    }
+    return odd;
+}
+
+/*
+ * Mirrors the board left to right (x -> 7 - x).
+ */
+static inline uint64_t mirrorBits(uint64_t b) {
+    b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+    b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+    b = ((b >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((b & 0x0f0f0f0f0f0f0f0fULL) << 4);
+    return b;
+}
+
+/*
+ * Flips the board top to bottom (y -> 7 - y).
+ */
+static inline uint64_t flipBits(uint64_t b) {
+    return __builtin_bswap64(b);
+}
+
+/*
+ * Reflects the board in its main diagonal (x <-> y).
+ */
+static inline uint64_t transposeBits(uint64_t b) {
+    uint64_t t;
+    t = (b ^ (b >> 7)) & 0x00aa00aa00aa00aaULL;
+    b ^= t ^ (t << 7);
+    t = (b ^ (b >> 14)) & 0x0000cccc0000ccccULL;
+    b ^= t ^ (t << 14);
+    t = (b ^ (b >> 28)) & 0x00000000f0f0f0f0ULL;
+    b ^= t ^ (t << 28);
+    return b;
+}
+
+/*
+ * Applies one of the 8 symmetries of the board: bit 2 of sym transposes,
+ * then bit 0 mirrors and bit 1 flips. 3 is the half turn, 5 and 6 the
+ * quarter turns, and SYMMETRY_INVERSE[sym] undoes sym.
+ */
+static inline uint64_t transformBits(uint64_t b, int sym) {
+    if (sym & 4) b = transposeBits(b);
+    if (sym & 1) b = mirrorBits(b);
+    if (sym & 2) b = flipBits(b);
+    return b;
+}
+
+static constexpr int SYMMETRY_INVERSE[8] = {0, 1, 2, 3, 4, 6, 5, 7};
+
+/*
+ * Square that sq maps to under symmetry sym.
+ */
+static inline int transformSquare(int sq, int sym) {
+    return firstSquare(transformBits(1ULL << sq, sym));
+}
+
+#endif
@@ -1,15 +1,64 @@
 #include "board.hpp"
 
+const uint64_t ZOBRIST[2][64] = {
+  {
+        0xbe1f53ab723559caULL, 0x11051b6e0b8ae626ULL, 0xcf13b0ecdb1ae3d3ULL,
+        0x70437ab3506a274aULL, 0xe98bde9d44bdef14ULL, 0xb5eb0965c7a6e15eULL,
+        0x880c2f58e760e008ULL, 0x05531ce20c63c945ULL, 0x6782d224a46a6afaULL,
+        0x11350455e73143cbULL, 0x7980eb5a7b4c2b9aULL, 0x9eae412f7c62c001ULL,
+        0x711f13f48385850bULL, 0xf4f4ec3dbf16381dULL, 0x0687e08b7a84e0d3ULL,
+        0x1df7775078aa1770ULL, 0xb13c1164c5807ea1ULL, 0x285a65d6a74ef302ULL,
+        0x48e4f82d12f714f2ULL, 0xaa29508b4191897eULL, 0xe5692b544c3f414cULL,
+        0x23b7279562f19d38ULL, 0x77c5b4cccba7054fULL, 0xe26b3501cfc4711dULL,
+        0x53948f8d21a2ac59ULL, 0xe2cc98f871dc9778ULL, 0x337f57468ac4630eULL,
+        0x8406f2d69aecbfa9ULL, 0x032f2f493a305b29ULL, 0x541d6990865044a2ULL,
+        0xe6700324f2a5c399ULL, 0x171a3a5b408886c7ULL, 0x59005f6f3f9e9693ULL,
+        0x93ea96823e8f5df2ULL, 0xdd482664e2dced74ULL, 0x3b57f3d667347b36ULL,
+        0x197b0269d0a50255ULL, 0x92b0c4e29a3f0853ULL, 0x9c33b0bf68a109a5ULL,
+        0xd220b1f78a6acaabULL, 0x7d0cb9acf6e7f44dULL, 0xae127f2d8fb82919ULL,
+        0x2585d4d2e86e3a79ULL, 0xc9cac5261edca8aaULL, 0x04faf387a8b4cac4ULL,
+        0x7389dfb1e2c1f03fULL, 0x11fb45219f5da484ULL, 0xdf8e24524a9dd43aULL,
+        0x20e77b70a5652f3eULL, 0x59870de139c4ae28ULL, 0x55019dc454439aceULL,
+        0x71cf40317154b853ULL, 0x0cecb2ba514cc53aULL, 0x688e2c70104894f7ULL,
+        0xecb1eb95f0de1462ULL, 0x9bbd2e3fc974e421ULL, 0xdc76c36c5140fa48ULL,
+        0xdff81d24fc824704ULL, 0xf3654dcdb80b081eULL, 0x8d04b0e36c1f9f7cULL,
+        0x68e0aac92b71856dULL, 0xe61a646d3a07868fULL, 0x0c0ae0f6aed29ec9ULL,
+        0x3ed676621c8c36a5ULL,
+  },
+  {
+        0xc8197d23b9e3d1abULL, 0xb75d42a9f727f49fULL, 0xab7bdb48f53272a7ULL,
+        0x7a4b62969a54a3e6ULL, 0xfcf873f1a15362a0ULL, 0x8557996bebdb9c98ULL,
+        0x220e210b5b33b8d6ULL, 0x23433613603e2812ULL, 0x06465addf88b10b8ULL,
+        0x3ec3b3015a285a00ULL, 0xa311c37ec2dfe95cULL, 0x0844289ffbc8d3a5ULL,
+        0x337bcd34025a279eULL, 0xa29ba0519a96fd58ULL, 0x9d2251da65409993ULL,
+        0x8435cda2cb697521ULL, 0x686b855d4d2ff8f9ULL, 0xa55417b9789d4bb1ULL,
+        0x04bd97d036bbc089ULL, 0xc7626034aa605039ULL, 0xb12f32049d4ccab5ULL,
+        0x29944bbc2d0df2f6ULL, 0x23782303881d5e96ULL, 0xd6055fe7c52923fdULL,
+        0x299a972acaf07cd1ULL, 0x676d3c14f841e878ULL, 0xccb404881703a83dULL,
+        0x54eb2f41b10e7dfaULL, 0x2c5b63e448611193ULL, 0x694b02a2546f1368ULL,
+        0xf62e99e0533ef78eULL, 0xaa6f5214f99f0740ULL, 0x5b8f75dc87d4ede0ULL,
+        0xfc8cbcb7f8d92610ULL, 0x4cd69e05981b7a2eULL, 0xbd16ecc9d8c1b73cULL,
+        0xab47ad40d849bc1cULL, 0x00fedf280c7f3ea5ULL, 0xbbb6221eaee606e9ULL,
+        0xce4fd45a1f6f8af5ULL, 0xe18d3e12229e507fULL, 0x260871159fa8abd7ULL,
+        0xeacdb45707793c83ULL, 0x31bf7f4feb96aeb3ULL, 0x7eebc31bf343f21aULL,
+        0x19ece45cdbb2812eULL, 0x352152faab55bb24ULL, 0x40ce4ade907a8c9aULL,
+        0x93f2ab848a3301e4ULL, 0x06b6307ef861de7cULL, 0xe99f8d0496f70730ULL,
+        0x4c9fe86cefcd357dULL, 0x713635f3e6b0ebd3ULL, 0x50c92924fee2861eULL,
+        0x3806f02959624a11ULL, 0x46be6604d60dd34fULL, 0xc96a1951b0a55406ULL,
+        0xeefa2fd7fb9cb59bULL, 0x52fe9284a747666aULL, 0x5451f8a44387d1caULL,
+        0xf6afd49e734dc6feULL, 0x9fc4985be566f0a5ULL, 0x123edd69a980113bULL,
+        0x760bdec5a3c25d56ULL,
+  }
+};
+
 /*
  * Make a standard 8x8 othello board and initialize it to the standard setup.
  */
 Board::Board() {
-    taken.set(3 + 8 * 3);
-    taken.set(3 + 8 * 4);
-    taken.set(4 + 8 * 3);
-    taken.set(4 + 8 * 4);
-    black.set(4 + 8 * 3);
-    black.set(3 + 8 * 4);
+    pieces[WHITE] = (1ULL << (3 + 8 * 3)) | (1ULL << (4 + 8 * 4));
+    pieces[BLACK] = (1ULL << (4 + 8 * 3)) | (1ULL << (3 + 8 * 4));
+    hash = computeHash();
+    parity = oddQuadrants(~getTaken());
 }
 
 /*
@@ -23,22 +72,29 @@ Board::~Board() {
  */
 Board *Board::copy() {
     Board *newBoard = new Board();
-    newBoard->black = black;
-    newBoard->taken = taken;
+    newBoard->pieces[WHITE] = pieces[WHITE];
+    newBoard->pieces[BLACK] = pieces[BLACK];
+    newBoard->hash = hash;
+    newBoard->parity = parity;
     return newBoard;
 }
 
 bool Board::occupied(int x, int y) {
-    return taken[x + 8*y];
+    return (getTaken() >> (x + 8*y)) & 1;
 }
 
 bool Board::get(Side side, int x, int y) {
-    return occupied(x, y) && (black[x + 8*y] == (side == BLACK));
+    return (pieces[side] >> (x + 8*y)) & 1;
 }
 
 void Board::set(Side side, int x, int y) {
-    taken.set(x + 8*y);
-    black.set(x + 8*y, side == BLACK);
+    int sq = x + 8*y;
+    uint64_t bit = 1ULL << sq;
+    if (pieces[opponent(side)] & bit) hash ^= ZOBRIST[opponent(side)][sq];
+    if (!(pieces[side] & bit)) hash ^= ZOBRIST[side][sq];
+    if (!(getTaken() & bit)) parity ^= QUADRANT[quadrantOf(sq)];
+    pieces[side] |= bit;
+    pieces[opponent(side)] &= ~bit;
 }
 
 bool Board::onBoard(int x, int y) {
@@ -51,20 +107,23 @@ bool Board::onBoard(int x, int y) {
  * if neither side has a legal move.
  */
 bool Board::isDone() {
-    return !(hasMoves(BLACK) || hasMoves(WHITE));
+    return !(generateMoves(BLACK) | generateMoves(WHITE));
 }
 
 /*
  * Returns true if there are legal moves for the given side.
  */
 bool Board::hasMoves(Side side) {
-    for (int i = 0; i < 8; i++) {
-        for (int j = 0; j < 8; j++) {
-            Move move(i, j);
-            if (checkMove(&move, side)) return true;
-        }
-    }
-    return false;
+    return generateMoves(side) != 0;
+}
+
+/*
+ * Returns the mask of legal moves for the given side, computed for all 64
+ * squares at once with a shift-and-mask flood fill in each of the 8
+ * directions.
+ */
+uint64_t Board::generateMoves(Side side) const {
+    return legalMoves(pieces[side], pieces[opponent(side)]);
 }
 
 /*
@@ -76,29 +135,9 @@ bool Board::checkMove(Move *m, Side side) {
 
     int X = m->getX();
     int Y = m->getY();
+    if (!onBoard(X, Y)) return false;
 
-    // Make sure the square hasn't already been taken.
-    if (occupied(X, Y)) return false;
-
-    Side other = (side == BLACK) ? WHITE : BLACK;
-    for (int dx = -1; dx <= 1; dx++) {
-        for (int dy = -1; dy <= 1; dy++) {
-            if (dy == 0 && dx == 0) continue;
-
-            // Is there a capture in that direction?
-            int x = X + dx;
-            int y = Y + dy;
-            if (onBoard(x, y) && get(other, x, y)) {
-                do {
-                    x += dx;
-                    y += dy;
-                } while (onBoard(x, y) && get(other, x, y));
-
-                if (onBoard(x, y) && get(side, x, y)) return true;
-            }
-        }
-    }
-    return false;
+    return (generateMoves(side) >> (X + 8*Y)) & 1;
 }
 
 /*
@@ -111,55 +150,66 @@ void Board::doMove(Move *m, Side side) {
     // Ignore if move is invalid.
     if (!checkMove(m, side)) return;
 
-    int X = m->getX();
-    int Y = m->getY();
-    Side other = (side == BLACK) ? WHITE : BLACK;
-    for (int dx = -1; dx <= 1; dx++) {
-        for (int dy = -1; dy <= 1; dy++) {
-            if (dy == 0 && dx == 0) continue;
-
-            int x = X;
-            int y = Y;
-            do {
-                x += dx;
-                y += dy;
-            } while (onBoard(x, y) && get(other, x, y));
-
-            if (onBoard(x, y) && get(side, x, y)) {
-                x = X;
-                y = Y;
-                x += dx;
-                y += dy;
-                while (onBoard(x, y) && get(other, x, y)) {
-                    set(side, x, y);
-                    x += dx;
-                    y += dy;
-                }
-            }
-        }
+    makeMove(m->getX() + 8 * m->getY(), side);
+}
+
+/*
+ * Returns the discs that the given side would flip by playing on square
+ * (x + 8*y). Zero means the move is illegal or the square is taken.
+ */
+uint64_t Board::flips(int square, Side side) const {
+    if ((getTaken() >> square) & 1) return 0;
+    return discFlips(square, pieces[side], pieces[opponent(side)]);
+}
+
+/*
+ * Plays a legal move in place and returns the flipped discs, which
+ * unmakeMove needs to take it back.
+ */
+uint64_t Board::makeMove(int square, Side side) {
+    return (side == BLACK) ? makeMove<BLACK>(square) : makeMove<WHITE>(square);
+}
+
+/*
+ * Takes back a move made with makeMove.
+ */
+void Board::unmakeMove(int square, Side side, uint64_t flipped) {
+    if (side == BLACK) {
+        unmakeMove<BLACK>(square, flipped);
+    } else {
+        unmakeMove<WHITE>(square, flipped);
     }
-    set(side, X, Y);
+}
+
+/*
+ * Returns the board after the given side plays a legal move, leaving this
+ * board untouched.
+ */
+Board Board::apply(int square, Side side) const {
+    Board next = *this;
+    next.makeMove(square, side);
+    return next;
 }
 
 /*
  * Current count of given side's stones.
  */
 int Board::count(Side side) {
-    return (side == BLACK) ? countBlack() : countWhite();
+    return popCount(pieces[side]);
 }
 
 /*
  * Current count of black stones.
  */
 int Board::countBlack() {
-    return black.count();
+    return popCount(pieces[BLACK]);
 }
 
 /*
  * Current count of white stones.
  */
 int Board::countWhite() {
-    return taken.count() - black.count();
+    return popCount(pieces[WHITE]);
 }
 
 /*
@@ -167,14 +217,109 @@ int Board::countWhite() {
  * piece and 'b' indicates a black piece. Mainly for testing purposes.
  */
 void Board::setBoard(char data[]) {
-    taken.reset();
-    black.reset();
+    pieces[WHITE] = 0;
+    pieces[BLACK] = 0;
     for (int i = 0; i < 64; i++) {
         if (data[i] == 'b') {
-            taken.set(i);
-            black.set(i);
+            pieces[BLACK] |= 1ULL << i;
         } if (data[i] == 'w') {
-            taken.set(i);
+            pieces[WHITE] |= 1ULL << i;
+        }
+    }
+    hash = computeHash();
+    parity = oddQuadrants(~getTaken());
+}
+
+/*
+ * Returns the board mapped through one of the 8 symmetries (see
+ * transformBits).
+ */
+Board Board::transform(int symmetry) const {
+    Board result;
+    result.setPieces(transformBits(pieces[BLACK], symmetry),
+                     transformBits(pieces[WHITE], symmetry));
+    return result;
+}
+
+/*
+ * Finds the canonical form of the position: of its 8 orientations, the one
+ * with the smallest (black, white) pair, earliest symmetry first on ties.
+ * Stores its discs and returns the symmetry that produces it. All 8 come
+ * from one transpose per side plus mirrors and byte swaps.
+ */
+int Board::canonicalForm(uint64_t *black, uint64_t *white) const {
+    uint64_t b[8], w[8];
+    b[0] = pieces[BLACK];
+    w[0] = pieces[WHITE];
+    b[4] = transposeBits(b[0]);
+    w[4] = transposeBits(w[0]);
+    for (int base = 0; base < 8; base += 4) {
+        b[base + 1] = mirrorBits(b[base]);
+        w[base + 1] = mirrorBits(w[base]);
+        b[base + 2] = flipBits(b[base]);
+        w[base + 2] = flipBits(w[base]);
+        b[base + 3] = flipBits(b[base + 1]);
+        w[base + 3] = flipBits(w[base + 1]);
+    }
+
+    int best = 0;
+    for (int sym = 1; sym < 8; sym++) {
+        if (b[sym] < b[best] || (b[sym] == b[best] && w[sym] < w[best])) {
+            best = sym;
+        }
+    }
+    *black = b[best];
+    *white = w[best];
+    return best;
+}
+
+/*
+ * Murmur3's 64-bit finalizer.
+ */
+static inline uint64_t mix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+/*
+ * Hash shared by all 8 orientations of the position; the symmetry that
+ * maps this board to the canonical form is stored in *symmetry if it isn't
+ * null. Computed from scratch, as the canonical form can change with any
+ * move, so it is much slower than getHash().
+ */
+uint64_t Board::getCanonicalHash(Side toMove, int *symmetry) const {
+    uint64_t black, white;
+    int sym = canonicalForm(&black, &white);
+    if (symmetry != nullptr) *symmetry = sym;
+
+    uint64_t w = mix(white ^ 0x9e3779b97f4a7c15ULL);
+    uint64_t h = mix(black) ^ ((w << 17) | (w >> 47));
+    return h ^ (ZOBRIST_BLACK_TO_MOVE & (0 - (uint64_t)toMove));
+}
+
+/*
+ * Replaces every disc on the board with the given bitboards.
+ */
+void Board::setPieces(uint64_t black, uint64_t white) {
+    pieces[BLACK] = black;
+    pieces[WHITE] = white;
+    hash = computeHash();
+    parity = oddQuadrants(~getTaken());
+}
+
+/*
+ * Zobrist hash of the discs computed from scratch.
+ */
+uint64_t Board::computeHash() const {
+    uint64_t h = 0;
+    for (int side = WHITE; side <= BLACK; side++) {
+        for (uint64_t b = pieces[side]; b; b &= b - 1) {
+            h ^= ZOBRIST[side][firstSquare(b)];
         }
     }
+    return h;
 }
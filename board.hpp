@@ -1,15 +1,27 @@
 #ifndef __BOARD_H__
 #define __BOARD_H__
 
-#include <bitset>
+#include <cstdint>
 #include "common.hpp"
+#include "bitboard.hpp"
 using namespace std;
 
+// Random keys for each side's disc on each square, indexed [side][x + 8*y].
+extern const uint64_t ZOBRIST[2][64];
+// Mixed into Board::getHash() when black is to move.
+static constexpr uint64_t ZOBRIST_BLACK_TO_MOVE = 0x377b0eec5b4ff40fULL;
+
 class Board {
 
 private:
-    bitset<64> black;
-    bitset<64> taken;
+    // One disc plane per side, indexed by Side.
+    uint64_t pieces[2];
+    // Zobrist hash of the discs, kept up to date by every move.
+    uint64_t hash;
+    // Quadrants with an odd number of empty squares, also kept up to date.
+    uint64_t parity;
+
+    uint64_t computeHash() const;
 
 public:
     Board();
@@ -29,7 +41,73 @@ public:
     int countBlack();
     int countWhite();
 
+    uint64_t generateMoves(Side side) const;
+    uint64_t flips(int square, Side side) const;
+    uint64_t makeMove(int square, Side side);
+    void unmakeMove(int square, Side side, uint64_t flipped);
+    template <Side side> uint64_t generateMoves() const;
+    template <Side side> uint64_t makeMove(int square);
+    template <Side side> void unmakeMove(int square, uint64_t flipped);
+    Board apply(int square, Side side) const;
+    uint64_t getPieces(Side side) const { return pieces[side]; }
+    uint64_t getTaken() const { return pieces[WHITE] | pieces[BLACK]; }
+    uint64_t getHash() const { return hash; }
+    uint64_t getParity() const { return parity; }
+    uint64_t getHash(Side toMove) const {
+        return hash ^ (ZOBRIST_BLACK_TO_MOVE & (0 - (uint64_t)toMove));
+    }
+
+    Board transform(int symmetry) const;
+    int canonicalForm(uint64_t *black, uint64_t *white) const;
+    uint64_t getCanonicalHash(Side toMove, int *symmetry) const;
+
     void setBoard(char data[]);
+    void setPieces(uint64_t black, uint64_t white);
 };
 
+/*
+ * The move primitives for a side fixed at compile time, which the search
+ * uses: both disc planes are at constant offsets, and the runtime versions
+ * in board.cpp just pick one of these.
+ */
+template <Side side>
+inline uint64_t Board::generateMoves() const {
+    return legalMoves(pieces[side], pieces[opponent(side)]);
+}
+
+/*
+ * Plays a legal move in place and returns the flipped discs, which
+ * unmakeMove needs to take it back.
+ */
+template <Side side>
+inline uint64_t Board::makeMove(int square) {
+    uint64_t flipped = discFlips(square, pieces[side], pieces[opponent(side)]);
+    pieces[side] ^= flipped | (1ULL << square);
+    pieces[opponent(side)] ^= flipped;
+    parity ^= QUADRANT[quadrantOf(square)];
+
+    hash ^= ZOBRIST[side][square];
+    for (uint64_t b = flipped; b; b &= b - 1) {
+        int sq = firstSquare(b);
+        hash ^= ZOBRIST[WHITE][sq] ^ ZOBRIST[BLACK][sq];
+    }
+    return flipped;
+}
+
+/*
+ * Takes back a move made with makeMove.
+ */
+template <Side side>
+inline void Board::unmakeMove(int square, uint64_t flipped) {
+    pieces[side] ^= flipped | (1ULL << square);
+    pieces[opponent(side)] ^= flipped;
+    parity ^= QUADRANT[quadrantOf(square)];
+
+    hash ^= ZOBRIST[side][square];
+    for (uint64_t b = flipped; b; b &= b - 1) {
+        int sq = firstSquare(b);
+        hash ^= ZOBRIST[WHITE][sq] ^ ZOBRIST[BLACK][sq];
+    }
+}
+
 #endif
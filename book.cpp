@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "book.hpp"
+
+using namespace std;
+
+static bool entryLess(const BookEntry &a, const BookEntry &b) {
+    return a.key < b.key;
+}
+
+/*
+ * Sorts the entries and writes them in the format OpeningBook::load reads.
+ * Of several entries for one key, the deepest is kept. The file is written
+ * under a temporary name, synced and renamed into place, so engines that
+ * have the old book mapped keep reading it intact and a crash never leaves
+ * a torn book.
+ */
+bool bookSave(const char *path, vector<BookEntry> &entries) {
+    stable_sort(entries.begin(), entries.end(), entryLess);
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (kept > 0 && entries[kept - 1].key == entries[i].key) {
+            if (entries[i].depth > entries[kept - 1].depth) {
+                entries[kept - 1] = entries[i];
+            }
+        } else {
+            entries[kept++] = entries[i];
+        }
+    }
+    entries.resize(kept);
+
+    string temporary = string(path) + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == nullptr) return false;
+
+    BookFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BOOK_FILE_MAGIC, sizeof(header.magic));
+    header.version = BOOK_FILE_VERSION;
+    header.count = kept;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(entries.data(), sizeof(BookEntry), kept, file) == kept &&
+              fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+    if (ok) ok = (rename(temporary.c_str(), path) == 0);
+    if (!ok) remove(temporary.c_str());
+    return ok;
+}
+
+OpeningBook::OpeningBook() {
+    map = nullptr;
+    mapSize = 0;
+    entries = nullptr;
+    count = 0;
+}
+
+OpeningBook::~OpeningBook() {
+    if (map != nullptr) munmap(map, mapSize);
+}
+
+/*
+ * Memory-maps a book written by bookSave. Only the pages a lookup touches
+ * are read in, so this costs next to nothing at startup. Returns false,
+ * leaving the book empty, if the file is missing or malformed.
+ */
+bool OpeningBook::load(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BookFileHeader)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    const BookFileHeader *header = (const BookFileHeader *)mapped;
+    if (memcmp(header->magic, BOOK_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != BOOK_FILE_VERSION ||
+        size != sizeof(BookFileHeader) +
+                (size_t)header->count * sizeof(BookEntry)) {
+        munmap(mapped, size);
+        return false;
+    }
+
+    if (map != nullptr) munmap(map, mapSize);
+    map = mapped;
+    mapSize = size;
+    entries = (const BookEntry *)(header + 1);
+    count = header->count;
+    return true;
+}
+
+/*
+ * Returns the entry stored under key, or null.
+ */
+const BookEntry *OpeningBook::find(uint64_t key) const {
+    size_t low = 0, high = count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (entries[mid].key < key) low = mid + 1;
+        else high = mid;
+    }
+    if (low < count && entries[low].key == key) return &entries[low];
+    return nullptr;
+}
+
+/*
+ * Returns the book move (x + 8*y) for `side` in this position, or -1 if the
+ * position isn't in the book or its move isn't legal here.
+ */
+int OpeningBook::probe(const Board &board, Side side) const {
+    if (count == 0) return -1;
+
+    int symmetry;
+    const BookEntry *entry = find(board.getCanonicalHash(side, &symmetry));
+    if (entry == nullptr || entry->move >= 64) return -1;
+
+    int sq = transformSquare(entry->move, SYMMETRY_INVERSE[symmetry]);
+    if (((board.generateMoves(side) >> sq) & 1) == 0) return -1;
+    return sq;
+}
@@ -0,0 +1,65 @@
+#ifndef __BOOK_H__
+#define __BOOK_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "common.hpp"
+#include "board.hpp"
+
+/*
+ * Opening book. Every position is stored once under its canonical hash
+ * (Board::getCanonicalHash), so the book answers for all 8 orientations of
+ * a line it has seen. The file is an array of entries sorted by key, looked
+ * up by binary search straight from a read-only mapping.
+ */
+
+// Book Player maps at startup if it exists.
+#define BOOK_FILE "heartizach.book"
+#define BOOK_FILE_MAGIC "HZBOOK\0"
+#define BOOK_FILE_VERSION 2
+
+/*
+ * Header of a book file. It is followed by `count` BookEntry records in
+ * ascending key order, in host byte order.
+ */
+struct BookFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+};
+
+/*
+ * One book position. The move is a square of the canonical orientation.
+ */
+struct BookEntry {
+    uint64_t key;
+    // Search score for the side to move, in evaluation units.
+    int16_t score;
+    // Depth of the search that chose the move.
+    uint8_t depth;
+    uint8_t move;
+    uint32_t reserved;
+};
+
+bool bookSave(const char *path, std::vector<BookEntry> &entries);
+
+class OpeningBook {
+
+public:
+    OpeningBook();
+    ~OpeningBook();
+
+    bool load(const char *path);
+    int probe(const Board &board, Side side) const;
+    const BookEntry *find(uint64_t key) const;
+    size_t getSize() const { return count; }
+
+private:
+    void *map;
+    size_t mapSize;
+    const BookEntry *entries;
+    size_t count;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "board.hpp"
+#include "eval.hpp"
+#include "search.hpp"
+
+using namespace std;
+
+/*
+ * Calibrates Multi-ProbCut. Every corpus position is searched without
+ * selectivity to each depth up to the maximum, and for every stage and
+ * depth the deep scores are fitted by linear regression on the scores of
+ * the matching shallow search (mpcShallowDepth). The slope, offset and
+ * standard deviation of the residuals are written with the evaluation
+ * weights in use into a version 2 weight file.
+ *
+ *   calibrate corpus [-o weights] [-d max-depth] [-n positions] [-t threads]
+ *
+ * The corpus has the format train reads; only the squares and the side to
+ * move are used, so positions from self-play games are the natural input.
+ * Pairs with fewer than MIN_SAMPLES positions are left uncalibrated, which
+ * keeps ProbCut off for them.
+ */
+
+static const int MIN_SAMPLES = 32;
+// Table size for each thread's searches; cleared for every position.
+static const size_t TT_MEGABYTES = 8;
+
+struct Position {
+    Board board;
+    Side toMove;
+};
+
+// Sums for the regression of one (stage, depth) pair.
+struct Fit {
+    double n, x, y, xx, xy, yy;
+};
+
+static vector<Position> positions;
+static atomic<size_t> nextPosition(0);
+static int maxDepth = 10;
+
+static bool parsePosition(const char *line, Position *position) {
+    if (strlen(line) < 66 || line[64] != ' ') return false;
+    if (line[65] != 'b' && line[65] != 'w') return false;
+
+    char data[64];
+    for (int i = 0; i < 64; i++) {
+        data[i] = (line[i] == 'b' || line[i] == 'w') ? line[i] : ' ';
+    }
+    position->board.setBoard(data);
+    position->toMove = (line[65] == 'b') ? BLACK : WHITE;
+    return true;
+}
+
+/*
+ * Searches positions until none are left, adding each (shallow, deep)
+ * score pair to fits[stage][depth].
+ */
+static void worker(vector<Fit> *fits) {
+    TranspositionTable table(TT_MEGABYTES);
+    Search search;
+    search.setTable(&table);
+    search.setSelective(false);
+
+    int scores[MPC_MAX_DEPTH + 1];
+    for (size_t i = nextPosition++; i < positions.size(); i = nextPosition++) {
+        const Position &position = positions[i];
+        int empties = 64 - popCount(position.board.getTaken());
+        if (position.board.generateMoves(position.toMove) == 0) continue;
+
+        table.clear();
+        int reached = 0;
+        for (int depth = 1; depth <= maxDepth && depth < empties; depth++) {
+            search.run(position.board, position.toMove, depth, -1);
+            scores[depth] = search.getScore();
+            // Results that see the end of the game don't fit the line.
+            if (scores[depth] >= SCORE_WIN || scores[depth] <= -SCORE_WIN) {
+                break;
+            }
+            reached = depth;
+        }
+
+        int stage = evalStage(empties);
+        for (int depth = MPC_MIN_DEPTH; depth <= reached; depth++) {
+            double x = scores[mpcShallowDepth(depth)];
+            double y = scores[depth];
+            Fit &fit = (*fits)[stage * (MPC_MAX_DEPTH + 1) + depth];
+            fit.n += 1;
+            fit.x += x;
+            fit.y += y;
+            fit.xx += x * x;
+            fit.xy += x * y;
+            fit.yy += y * y;
+        }
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s corpus [-o weights] [-d max-depth] "
+                    "[-n positions] [-t threads]\n", name);
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) usage(argv[0]);
+
+    const char *corpus = argv[1];
+    const char *output = EVAL_WEIGHTS_FILE;
+    size_t limit = 20000;
+    int threads = thread::hardware_concurrency();
+
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 >= argc) usage(argv[0]);
+        if (!strcmp(argv[i], "-o")) output = argv[++i];
+        else if (!strcmp(argv[i], "-d")) maxDepth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n")) limit = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-t")) threads = atoi(argv[++i]);
+        else usage(argv[0]);
+    }
+    if (threads < 1) threads = 1;
+    if (maxDepth > MPC_MAX_DEPTH) maxDepth = MPC_MAX_DEPTH;
+
+    FILE *file = fopen(corpus, "r");
+    if (file == nullptr) {
+        fprintf(stderr, "can't open %s\n", corpus);
+        return 1;
+    }
+    char line[256];
+    while (positions.size() < limit && fgets(line, sizeof(line), file)) {
+        Position position;
+        if (parsePosition(line, &position)) positions.push_back(position);
+    }
+    fclose(file);
+    if (positions.empty()) {
+        fprintf(stderr, "no positions in %s\n", corpus);
+        return 1;
+    }
+
+    // Calibrates against the weights the engine would load.
+    evalInit();
+
+    size_t pairs = (size_t)EVAL_NUM_STAGES * (MPC_MAX_DEPTH + 1);
+    vector<vector<Fit> > fits(threads, vector<Fit>(pairs, Fit()));
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread(worker, &fits[t]));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+
+    EvalMpcTable table;
+    memset(&table, 0, sizeof(table));
+    int calibrated = 0;
+    for (int stage = 0; stage < EVAL_NUM_STAGES; stage++) {
+        for (int depth = MPC_MIN_DEPTH; depth <= maxDepth; depth++) {
+            Fit sum = Fit();
+            for (int t = 0; t < threads; t++) {
+                const Fit &fit = fits[t][stage * (MPC_MAX_DEPTH + 1) + depth];
+                sum.n += fit.n;
+                sum.x += fit.x;
+                sum.y += fit.y;
+                sum.xx += fit.xx;
+                sum.xy += fit.xy;
+                sum.yy += fit.yy;
+            }
+            if (sum.n < MIN_SAMPLES) continue;
+
+            double varX = sum.xx - sum.x * sum.x / sum.n;
+            double covXY = sum.xy - sum.x * sum.y / sum.n;
+            if (varX <= 0) continue;
+            double slope = covXY / varX;
+            double offset = (sum.y - slope * sum.x) / sum.n;
+            // Residual sum of squares of the fitted line.
+            double residual = sum.yy - 2 * slope * sum.xy - 2 * offset * sum.y +
+                              slope * slope * sum.xx +
+                              2 * slope * offset * sum.x +
+                              offset * offset * sum.n;
+            double sigma = sqrt((residual > 0 ? residual : 0) / sum.n);
+            if (slope <= 0) continue;
+
+            MpcParams &params = table.params[stage][depth];
+            params.slope = (float)slope;
+            params.offset = (float)offset;
+            // A perfect fit still needs a margin.
+            params.sigma = (float)((sigma > 1) ? sigma : 1);
+            calibrated++;
+            fprintf(stderr, "stage %d depth %2d (from %d): %6.0f samples, "
+                            "slope %.3f offset %+7.1f sigma %6.1f\n",
+                    stage, depth, mpcShallowDepth(depth), sum.n, slope,
+                    offset, sigma);
+        }
+    }
+
+    if (!evalSave(output, evalWeights(), &table)) {
+        fprintf(stderr, "can't write %s\n", output);
+        return 1;
+    }
+    fprintf(stderr, "wrote %s with %d calibrated pairs\n", output, calibrated);
+    return 0;
+}
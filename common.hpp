@@ -1,10 +1,36 @@
 #ifndef __COMMON_H__
 #define __COMMON_H__
 
+#include <cstdint>
+
+#define NUM_OTHELLO_SQUARES 8
+// Capacity of a MoveList: one entry per square, so it can never overflow.
+#define MAX_MOVES 64
+
 enum Side {
     WHITE, BLACK
 };
 
+/*
+ * The other side. Side values are 0 and 1, so this is a single xor, and it
+ * can be evaluated at compile time for a template argument.
+ */
+constexpr Side opponent(Side side) {
+    return (Side)(side ^ 1);
+}
+
+static constexpr short HEURISTIC[NUM_OTHELLO_SQUARES][NUM_OTHELLO_SQUARES] =
+{
+  {  255,  -64,   32,   16,   16,   32,  -64,  255},
+  {  -64, -128,   32,    4,    4,   32, -128,  -64},
+  {   32,   32,   32,    4,    4,   32,   32,   32},
+  {   16,    4,    4,    4,    4,    4,    4,   16},
+  {   16,    4,    4,    4,    4,    4,    4,   16},
+  {   32,   32,   32,    4,    4,   32,   32,   32},
+  {  -64, -128,   32,    4,    4,   32, -128,  -64},
+  {  255,  -64,   32,   16,   16,   32,  -64,  255}
+};
+
 class Move {
 
 public:
@@ -22,4 +48,23 @@ public:
     void setY(int y) { this->y = y; }
 };
 
+/*
+ * A move packed into one byte: its square, x + 8*y.
+ */
+typedef uint8_t PackedMove;
+
+/*
+ * Fixed-capacity list of packed moves. It lives on the stack or inside its
+ * owner, so building one never touches the heap.
+ */
+struct MoveList {
+    PackedMove squares[MAX_MOVES];
+    int size;
+
+    MoveList() { size = 0; }
+    void push(int sq) { squares[size++] = (PackedMove)sq; }
+    void pop() { size--; }
+    int operator[](int i) const { return squares[i]; }
+};
+
 #endif
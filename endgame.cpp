@@ -0,0 +1,450 @@
+#include "endgame.hpp"
+
+using namespace std;
+
+// Scores lie in [-64, 64]; this is outside that range.
+static const int ENDGAME_INF = 65;
+
+// At or below this many empties the solver drops the Board, hashing and
+// mobility ordering, and searches raw bitboards in parity order.
+static const int SHALLOW_EMPTIES = 6;
+
+static const uint64_t NODES_PER_TIME_CHECK = 4096;
+
+static const uint64_t CORNERS = 0x8100000000000081ULL;
+
+/*
+ * Final disc differential for the side owning `own`; empty squares go to
+ * the winner.
+ */
+static inline int finalDiff(uint64_t own, uint64_t opp) {
+    int diff = popCount(own) - popCount(opp);
+    int empties = 64 - popCount(own | opp);
+    if (diff > 0) return diff + empties;
+    if (diff < 0) return diff - empties;
+    return 0;
+}
+
+Endgame::Endgame(size_t cache_megabytes) : cache(cache_megabytes) {
+    stopFlag = nullptr;
+    canonical = false;
+    limited = false;
+    stopped = false;
+    nodes = 0;
+    cacheProbes = 0;
+    cacheHits = 0;
+    bestScore = 0;
+}
+
+Endgame::~Endgame() {
+}
+
+/*
+ * Solves the position exactly with `side` to move and returns the best
+ * square, or -1 if the side has to pass. If msBudget (negative for no limit)
+ * runs out or the stop flag is raised first, wasStopped() is true and the
+ * result must not be used.
+ */
+int Endgame::solve(const Board &board, Side side, int msBudget) {
+    Board root = board;
+    Side other = opponent(side);
+    uint64_t own = root.getPieces(side);
+    uint64_t opp = root.getPieces(other);
+    int empties = 64 - popCount(own | opp);
+
+    nodes = 0;
+    cacheProbes = 0;
+    cacheHits = 0;
+    stopped = false;
+    limited = (msBudget >= 0);
+    deadline = chrono::steady_clock::now() + chrono::milliseconds(msBudget);
+    cache.newSearch();
+
+    uint64_t moves = legalMoves(own, opp);
+    if (moves == 0) return -1;
+
+    int order[NUM_OTHELLO_SQUARES * NUM_OTHELLO_SQUARES];
+    int numMoves = orderMoves(own, opp, root.getParity(), moves, order);
+
+    // The move stored by an earlier solve goes first.
+    TTData hit;
+    int symmetry;
+    uint64_t rootKey = cacheKey(root, side, &symmetry);
+    if (cache.probe(rootKey, &hit) && hit.move != TT_NO_MOVE) {
+        int move = transformSquare(hit.move, SYMMETRY_INVERSE[symmetry]);
+        for (int i = 1; i < numMoves; i++) {
+            if (order[i] == move) {
+                order[i] = order[0];
+                order[0] = move;
+                break;
+            }
+        }
+    }
+
+    int alpha = -ENDGAME_INF;
+    int bestMove = order[0];
+    for (int i = 0; i < numMoves; i++) {
+        uint64_t flipped = root.makeMove(order[i], side);
+        int score;
+        if (i == 0) {
+            score = -searchDeep(root, other, -ENDGAME_INF, ENDGAME_INF, false,
+                                empties - 1);
+        } else {
+            score = -searchDeep(root, other, -alpha - 1, -alpha, false,
+                                empties - 1);
+            if (score > alpha) {
+                score = -searchDeep(root, other, -ENDGAME_INF, -alpha, false,
+                                    empties - 1);
+            }
+        }
+        root.unmakeMove(order[i], side, flipped);
+        if (stopped) return -1;
+
+        if (score > alpha) {
+            alpha = score;
+            bestMove = order[i];
+        }
+    }
+
+    bestScore = alpha;
+    cache.store(rootKey, empties, BOUND_EXACT, alpha,
+                transformSquare(bestMove, symmetry));
+    return bestMove;
+}
+
+/*
+ * Writes the line the cache expects after `side` plays `first`, like
+ * Search::getPV. It ends where the solve went below the cached part of
+ * the tree.
+ */
+int Endgame::getPV(const Board &board, Side side, int first, int *pv,
+                   int maxLength) {
+    Board position = board;
+    int sq = first;
+    int length = 0;
+    while (sq >= 0 && length < maxLength) {
+        pv[length++] = sq;
+        position.makeMove(sq, side);
+        side = opponent(side);
+
+        uint64_t moves = position.generateMoves(side);
+        bool pass = (moves == 0);
+        if (pass) {
+            side = opponent(side);
+            moves = position.generateMoves(side);
+            if (moves == 0) break;
+        }
+
+        int symmetry;
+        TTData hit;
+        if (!cache.probe(cacheKey(position, side, &symmetry), &hit) ||
+            hit.move == TT_NO_MOVE) {
+            break;
+        }
+        sq = transformSquare(hit.move, SYMMETRY_INVERSE[symmetry]);
+        if (((moves >> sq) & 1) == 0) break;
+        if (pass) {
+            if (length == maxLength) break;
+            pv[length++] = STATS_PASS;
+        }
+    }
+    return length;
+}
+
+/*
+ * Stores a known exact result, such as one kept from an earlier game, in
+ * the cache: `side` to move scores `score` by playing `move`. An exact
+ * result already cached is kept.
+ */
+void Endgame::learn(const Board &board, Side side, int score, int move) {
+    int symmetry;
+    uint64_t key = cacheKey(board, side, &symmetry);
+    TTData known;
+    if (cache.probe(key, &known) && known.bound == BOUND_EXACT) return;
+    cache.store(key, 64 - popCount(board.getTaken()), BOUND_EXACT, score,
+                transformSquare(move, symmetry));
+}
+
+/*
+ * Cache key of the position; moves are stored mapped by *symmetry.
+ */
+uint64_t Endgame::cacheKey(const Board &board, Side side, int *symmetry) {
+    if (canonical) return board.getCanonicalHash(side, symmetry);
+    *symmetry = 0;
+    return board.getHash(side);
+}
+
+/*
+ * Sorts moves fastest-first: fewest replies for the opponent, with corners
+ * and moves into odd quadrants (`odd`, from Board::getParity) breaking ties.
+ * Returns the number of moves.
+ */
+int Endgame::orderMoves(uint64_t own, uint64_t opp, uint64_t odd,
+                        uint64_t moves, int *order) {
+    int keys[NUM_OTHELLO_SQUARES * NUM_OTHELLO_SQUARES];
+    int n = 0;
+
+    while (moves) {
+        int sq = firstSquare(moves);
+        moves &= moves - 1;
+
+        uint64_t bit = 1ULL << sq;
+        uint64_t flipped = discFlips(sq, own, opp);
+        int key = 16 * popCount(legalMoves(opp ^ flipped, own ^ flipped ^ bit));
+        if (bit & CORNERS) key -= 8;
+        if (bit & odd) key -= 4;
+
+        // Insertion sort; there are rarely more than a dozen moves.
+        int i = n++;
+        while (i > 0 && keys[i - 1] > key) {
+            keys[i] = keys[i - 1];
+            order[i] = order[i - 1];
+            i--;
+        }
+        keys[i] = key;
+        order[i] = sq;
+    }
+    return n;
+}
+
+/*
+ * Upper part of the tree: Board moves so the Zobrist hash is maintained for
+ * the cache, fastest-first ordering, and a clock check.
+ */
+int Endgame::searchDeep(Board &board, Side side, int alpha, int beta,
+                        bool passed, int empties) {
+    Side other = opponent(side);
+    uint64_t own = board.getPieces(side);
+    uint64_t opp = board.getPieces(other);
+    if (empties <= SHALLOW_EMPTIES) {
+        return searchShallow(own, opp, board.getParity(), alpha, beta, passed);
+    }
+
+    nodes++;
+    if (nodes % NODES_PER_TIME_CHECK == 0) {
+        if ((limited && chrono::steady_clock::now() >= deadline) ||
+            (stopFlag != nullptr && stopFlag->load(memory_order_relaxed))) {
+            stopped = true;
+        }
+    }
+    if (stopped) return 0;
+
+    uint64_t moves = legalMoves(own, opp);
+    if (moves == 0) {
+        if (passed) return finalDiff(own, opp);
+        return -searchDeep(board, other, -beta, -alpha, true, empties);
+    }
+
+    int symmetry;
+    uint64_t key = cacheKey(board, side, &symmetry);
+    int hashMove = TT_NO_MOVE;
+    TTData hit;
+    STATS_COUNT(cacheProbes);
+    if (cache.probe(key, &hit)) {
+        STATS_COUNT(cacheHits);
+        if (hit.move != TT_NO_MOVE) {
+            hashMove = transformSquare(hit.move, SYMMETRY_INVERSE[symmetry]);
+        }
+        if (hit.bound == BOUND_EXACT) return hit.score;
+        if (hit.bound == BOUND_LOWER && hit.score >= beta) return hit.score;
+        if (hit.bound == BOUND_UPPER && hit.score <= alpha) return hit.score;
+    }
+
+    int order[NUM_OTHELLO_SQUARES * NUM_OTHELLO_SQUARES];
+    int numMoves = orderMoves(own, opp, board.getParity(), moves, order);
+    for (int i = 1; i < numMoves; i++) {
+        if (order[i] == hashMove) {
+            order[i] = order[0];
+            order[0] = hashMove;
+            break;
+        }
+    }
+
+    int alphaOrig = alpha;
+    int best = -ENDGAME_INF;
+    int bestSq = TT_NO_MOVE;
+    for (int i = 0; i < numMoves; i++) {
+        // Principal variation search: later moves only need to be proven
+        // worse, which a null window does cheaply.
+        uint64_t flipped = board.makeMove(order[i], side);
+        int score;
+        if (i == 0) {
+            score = -searchDeep(board, other, -beta, -alpha, false,
+                                empties - 1);
+        } else {
+            score = -searchDeep(board, other, -alpha - 1, -alpha, false,
+                                empties - 1);
+            if (score > alpha && score < beta) {
+                score = -searchDeep(board, other, -beta, -alpha, false,
+                                    empties - 1);
+            }
+        }
+        board.unmakeMove(order[i], side, flipped);
+        if (stopped) return 0;
+
+        if (score > best) {
+            best = score;
+            bestSq = order[i];
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) break;
+            }
+        }
+    }
+
+    if (best <= alphaOrig) {
+        cache.store(key, empties, BOUND_UPPER, best, TT_NO_MOVE);
+    } else {
+        int bound = (best >= beta) ? BOUND_LOWER : BOUND_EXACT;
+        cache.store(key, empties, bound, best,
+                    transformSquare(bestSq, symmetry));
+    }
+    return best;
+}
+
+/*
+ * Lower part of the tree on raw bitboards: moves in odd quadrants first,
+ * then the rest, down to the last-three-empties routine. odd is the parity
+ * mask, updated move by move as Board does.
+ */
+int Endgame::searchShallow(uint64_t own, uint64_t opp, uint64_t odd,
+                           int alpha, int beta, bool passed) {
+    uint64_t empty = ~(own | opp);
+    if (popCount(empty) <= 3) {
+        int sq[3] = {TT_NO_MOVE, TT_NO_MOVE, TT_NO_MOVE};
+        int n = 0;
+        for (uint64_t b = empty; b; b &= b - 1) {
+            sq[n++] = firstSquare(b);
+        }
+        if (n == 3) return lastThree(own, opp, alpha, beta, sq[0], sq[1], sq[2]);
+        if (n == 2) return lastTwo(own, opp, alpha, beta, sq[0], sq[1]);
+        if (n == 1) return lastOne(own, opp, sq[0]);
+        return finalDiff(own, opp);
+    }
+
+    nodes++;
+    uint64_t moves = legalMoves(own, opp);
+    if (moves == 0) {
+        if (passed) return finalDiff(own, opp);
+        return -searchShallow(opp, own, odd, -beta, -alpha, true);
+    }
+
+    uint64_t groups[2] = {moves & odd, moves & ~odd};
+    int best = -ENDGAME_INF;
+    for (int g = 0; g < 2; g++) {
+        for (uint64_t b = groups[g]; b; b &= b - 1) {
+            int sq = firstSquare(b);
+            uint64_t flipped = discFlips(sq, own, opp);
+            int score = -searchShallow(opp ^ flipped,
+                                       own ^ flipped ^ (1ULL << sq),
+                                       odd ^ QUADRANT[quadrantOf(sq)],
+                                       -beta, -alpha, false);
+            if (score > best) {
+                best = score;
+                if (score > alpha) {
+                    alpha = score;
+                    if (alpha >= beta) return best;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+/*
+ * Three empty squares left. The square alone in its quadrant is tried
+ * first, since it doesn't hand the opponent a parity move.
+ */
+int Endgame::lastThree(uint64_t own, uint64_t opp, int alpha, int beta,
+                       int sq1, int sq2, int sq3) {
+    nodes++;
+    int q1 = quadrantOf(sq1), q2 = quadrantOf(sq2), q3 = quadrantOf(sq3);
+    if (q1 == q2 && q1 != q3) {
+        int t = sq1; sq1 = sq3; sq3 = sq2; sq2 = t;
+    } else if (q1 == q3 && q1 != q2) {
+        int t = sq1; sq1 = sq2; sq2 = t;
+    }
+
+    int squares[3][3] = {{sq1, sq2, sq3}, {sq2, sq1, sq3}, {sq3, sq1, sq2}};
+    int best = -ENDGAME_INF;
+    for (int i = 0; i < 3; i++) {
+        uint64_t flipped = discFlips(squares[i][0], own, opp);
+        if (flipped == 0) continue;
+
+        int score = -lastTwo(opp ^ flipped,
+                             own ^ flipped ^ (1ULL << squares[i][0]),
+                             -beta, -alpha, squares[i][1], squares[i][2]);
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) return best;
+            }
+        }
+    }
+    if (best != -ENDGAME_INF) return best;
+
+    // We pass; if the opponent can't move either, the game is over.
+    if (discFlips(sq1, opp, own) || discFlips(sq2, opp, own) ||
+        discFlips(sq3, opp, own)) {
+        return -lastThree(opp, own, -beta, -alpha, sq1, sq2, sq3);
+    }
+    return finalDiff(own, opp);
+}
+
+/*
+ * Two empty squares left.
+ */
+int Endgame::lastTwo(uint64_t own, uint64_t opp, int alpha, int beta,
+                     int sq1, int sq2) {
+    nodes++;
+    int best = -ENDGAME_INF;
+
+    uint64_t flipped = discFlips(sq1, own, opp);
+    if (flipped) {
+        best = -lastOne(opp ^ flipped, own ^ flipped ^ (1ULL << sq1), sq2);
+        if (best >= beta) return best;
+    }
+    flipped = discFlips(sq2, own, opp);
+    if (flipped) {
+        int score = -lastOne(opp ^ flipped, own ^ flipped ^ (1ULL << sq2),
+                             sq1);
+        if (score > best) best = score;
+    }
+    if (best != -ENDGAME_INF) return best;
+
+    // We pass: the opponent picks whichever reply is worst for us.
+    best = ENDGAME_INF;
+    flipped = discFlips(sq1, opp, own);
+    if (flipped) {
+        best = lastOne(own ^ flipped, opp ^ flipped ^ (1ULL << sq1), sq2);
+    }
+    flipped = discFlips(sq2, opp, own);
+    if (flipped) {
+        int score = lastOne(own ^ flipped, opp ^ flipped ^ (1ULL << sq2), sq1);
+        if (score < best) best = score;
+    }
+    if (best != ENDGAME_INF) return best;
+    return finalDiff(own, opp);
+}
+
+/*
+ * One empty square left: whoever can play it does, so only flip counts
+ * are needed.
+ */
+int Endgame::lastOne(uint64_t own, uint64_t opp, int sq) {
+    nodes++;
+    int ownCount = popCount(own);
+
+    int flips = popCount(discFlips(sq, own, opp));
+    if (flips) return 2 * (ownCount + flips + 1) - 64;
+
+    int oppCount = 63 - ownCount;
+    flips = popCount(discFlips(sq, opp, own));
+    if (flips) return 64 - 2 * (oppCount + flips + 1);
+
+    int diff = ownCount - oppCount;
+    if (diff > 0) return diff + 1;
+    if (diff < 0) return diff - 1;
+    return 0;
+}
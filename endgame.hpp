@@ -0,0 +1,69 @@
+#ifndef __ENDGAME_H__
+#define __ENDGAME_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "common.hpp"
+#include "board.hpp"
+#include "tt.hpp"
+#include "stats.hpp"
+
+// Exact solving takes over from the midgame search at this many empties.
+#define DEFAULT_ENDGAME_EMPTIES 16
+#define DEFAULT_ENDGAME_CACHE_MB 16
+
+class Endgame {
+
+public:
+    Endgame(size_t cache_megabytes = DEFAULT_ENDGAME_CACHE_MB);
+    ~Endgame();
+
+    void setStopFlag(std::atomic<bool> *flag) { this->stopFlag = flag; }
+    void setCanonical(bool on) { this->canonical = on; }
+    int solve(const Board &board, Side side, int msBudget);
+
+    // Exact final disc differential for the side that moved, with empty
+    // squares going to the winner.
+    int getScore() { return bestScore; }
+    bool wasStopped() { return stopped; }
+    uint64_t getNodes() { return nodes; }
+    // Cache lookups of the last solve, and those that found the position.
+    uint64_t getCacheProbes() { return cacheProbes; }
+    uint64_t getCacheHits() { return cacheHits; }
+    int getPV(const Board &board, Side side, int first, int *pv,
+              int maxLength);
+    void learn(const Board &board, Side side, int score, int move);
+
+private:
+    int searchDeep(Board &board, Side side, int alpha, int beta, bool passed,
+                   int empties);
+    int searchShallow(uint64_t own, uint64_t opp, uint64_t odd, int alpha,
+                      int beta, bool passed);
+    int lastThree(uint64_t own, uint64_t opp, int alpha, int beta,
+                  int sq1, int sq2, int sq3);
+    int lastTwo(uint64_t own, uint64_t opp, int alpha, int beta,
+                int sq1, int sq2);
+    int lastOne(uint64_t own, uint64_t opp, int sq);
+    int orderMoves(uint64_t own, uint64_t opp, uint64_t odd, uint64_t moves,
+                   int *order);
+    uint64_t cacheKey(const Board &board, Side side, int *symmetry);
+
+    // Exact results of the upper part of the tree, kept between moves.
+    TranspositionTable cache;
+    // Key the cache on canonical positions (see Search::setCanonical).
+    bool canonical;
+
+    // Raised by the owner to abandon the solve; may be null.
+    std::atomic<bool> *stopFlag;
+    std::chrono::steady_clock::time_point deadline;
+    bool limited;
+    bool stopped;
+
+    uint64_t nodes;
+    uint64_t cacheProbes;
+    uint64_t cacheHits;
+    int bestScore;
+};
+
+#endif
@@ -0,0 +1,370 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "eval.hpp"
+
+using namespace std;
+
+/*
+ * One pattern shape: its squares (x + 8*y) in base-3 digit order, lowest
+ * first, for the copy that touches the A1 corner or the top edge.
+ */
+struct PatternShape {
+    int size;
+    int squares[EVAL_MAX_PATTERN_SIZE];
+};
+
+static constexpr PatternShape PATTERNS[EVAL_NUM_PATTERNS] = {
+    // 3x3 corner block
+    {9, {0, 1, 8, 9, 2, 16, 10, 17, 18}},
+    // Edge plus both X-squares
+    {10, {9, 0, 1, 2, 3, 4, 5, 6, 7, 14}},
+    // 2x5 corner block
+    {10, {0, 1, 2, 3, 4, 8, 9, 10, 11, 12}},
+    // Second, third and fourth rows
+    {8, {8, 9, 10, 11, 12, 13, 14, 15}},
+    {8, {16, 17, 18, 19, 20, 21, 22, 23}},
+    {8, {24, 25, 26, 27, 28, 29, 30, 31}},
+    // Diagonals of length 8 down to 4
+    {8, {0, 9, 18, 27, 36, 45, 54, 63}},
+    {7, {8, 17, 26, 35, 44, 53, 62}},
+    {6, {16, 25, 34, 43, 52, 61}},
+    {5, {24, 33, 42, 51, 60}},
+    {4, {32, 41, 50, 59}}
+};
+
+static constexpr int POW3[EVAL_MAX_PATTERN_SIZE + 1] = {
+    1, 3, 9, 27, 81, 243, 729, 2187, 6561, 19683, 59049
+};
+
+// By Side: the digit of a new disc, and the change of a flipped disc's
+// digit.
+static constexpr int PLACED_DIGIT[2] = {2, 1};
+static constexpr int FLIP_CHANGE[2] = {1, -1};
+
+/*
+ * Where a square appears: which feature, and the power of 3 of its digit.
+ */
+struct SquareFeature {
+    int feature;
+    int power;
+};
+
+// Most features any one square belongs to.
+#define MAX_FEATURES_PER_SQUARE 8
+
+// Square lists of every feature, and the pattern each one uses.
+static int featureSquares[EVAL_NUM_FEATURES][EVAL_MAX_PATTERN_SIZE];
+static int featureSize[EVAL_NUM_FEATURES];
+static int featureOffset[EVAL_NUM_FEATURES];
+static SquareFeature squareFeatures[64][MAX_FEATURES_PER_SQUARE];
+static int squareFeatureCount[64];
+
+// Weight tables for every stage: a mapped weight file, or defaultWeights.
+static const int16_t *weights = nullptr;
+static vector<int16_t> defaultWeights;
+// ProbCut parameters from the weight file, or null.
+static const EvalMpcTable *mpcTable = nullptr;
+static once_flag initFlag;
+
+/*
+ * Expands every pattern shape into its distinct symmetric copies.
+ */
+static void buildFeatures() {
+    int feature = 0;
+    int offset = 0;
+
+    for (int p = 0; p < EVAL_NUM_PATTERNS; p++) {
+        vector<uint64_t> seen;
+        for (int s = 0; s < 8; s++) {
+            int squares[EVAL_MAX_PATTERN_SIZE];
+            uint64_t mask = 0;
+            for (int k = 0; k < PATTERNS[p].size; k++) {
+                squares[k] = transformSquare(PATTERNS[p].squares[k], s);
+                mask |= 1ULL << squares[k];
+            }
+
+            bool duplicate = false;
+            for (int i = 0; i < (int)seen.size(); i++) {
+                if (seen[i] == mask) duplicate = true;
+            }
+            if (duplicate) continue;
+            seen.push_back(mask);
+
+            featureSize[feature] = PATTERNS[p].size;
+            featureOffset[feature] = offset;
+            for (int k = 0; k < PATTERNS[p].size; k++) {
+                featureSquares[feature][k] = squares[k];
+                SquareFeature &entry =
+                    squareFeatures[squares[k]][squareFeatureCount[squares[k]]++];
+                entry.feature = feature;
+                entry.power = POW3[k];
+            }
+            feature++;
+        }
+        offset += POW3[PATTERNS[p].size];
+    }
+}
+
+/*
+ * Weights that reproduce the HEURISTIC square table: each square's value
+ * is split evenly between the features covering it. Used until trained
+ * weights are loaded.
+ */
+static void buildDefaultWeights() {
+    // A spare weight in front, like the header before a mapped file's: the
+    // AVX2 batch kernel loads each weight with the two bytes before it.
+    defaultWeights.assign((size_t)EVAL_NUM_STAGES * EVAL_WEIGHTS_PER_STAGE + 1,
+                          0);
+    int16_t *stageWeights = defaultWeights.data() + 1;
+
+    int offset = 0;
+    for (int p = 0; p < EVAL_NUM_PATTERNS; p++) {
+        const PatternShape &shape = PATTERNS[p];
+        for (int index = 0; index < POW3[shape.size]; index++) {
+            double value = 0;
+            for (int k = 0; k < shape.size; k++) {
+                int digit = (index / POW3[k]) % 3;
+                if (digit == 0) continue;
+
+                int sq = shape.squares[k];
+                double share = (double)HEURISTIC[sq % 8][sq / 8] /
+                               squareFeatureCount[sq];
+                value += (digit == 1) ? share : -share;
+            }
+            for (int stage = 0; stage < EVAL_NUM_STAGES; stage++) {
+                stageWeights[(size_t)stage * EVAL_WEIGHTS_PER_STAGE +
+                             offset + index] = (int16_t)lround(value);
+            }
+        }
+        offset += POW3[shape.size];
+    }
+    weights = stageWeights;
+}
+
+static void initOnce() {
+    buildFeatures();
+    if (!evalLoad(EVAL_WEIGHTS_FILE)) {
+        buildDefaultWeights();
+    }
+}
+
+/*
+ * Builds the feature tables and maps EVAL_WEIGHTS_FILE if there is one,
+ * falling back to the default weights. Safe to call repeatedly and from
+ * several threads.
+ */
+void evalInit() {
+    call_once(initFlag, initOnce);
+}
+
+/*
+ * Memory-maps a weight file written by evalSave and evaluates with it from
+ * now on. The pages are shared with other processes using the same file and
+ * are only read in as they are touched, so this is fast enough for startup.
+ * Version 1 files have no ProbCut table, which leaves selective search off.
+ * Returns false, leaving the weights alone, if the file is missing or
+ * doesn't match this build's layout.
+ */
+bool evalLoad(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    size_t base = sizeof(EvalFileHeader) +
+        (size_t)EVAL_NUM_STAGES * EVAL_WEIGHTS_PER_STAGE * sizeof(int16_t);
+    if (fstat(fd, &st) != 0 || ((size_t)st.st_size != base &&
+        (size_t)st.st_size != base + sizeof(EvalMpcTable))) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    const EvalFileHeader *header = (const EvalFileHeader *)map;
+    uint32_t version = (size == base) ? 1 : 2;
+    if (memcmp(header->magic, EVAL_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != version ||
+        header->stages != EVAL_NUM_STAGES ||
+        header->weightsPerStage != EVAL_WEIGHTS_PER_STAGE) {
+        munmap(map, size);
+        return false;
+    }
+
+    // The mapping lives as long as the process.
+    weights = (const int16_t *)(header + 1);
+    mpcTable = (version >= 2)
+        ? (const EvalMpcTable *)((const char *)map + base) : nullptr;
+    return true;
+}
+
+/*
+ * Writes EVAL_NUM_STAGES sets of weights, and the ProbCut table if there is
+ * one, in the format evalLoad reads. The file is written under a temporary
+ * name and renamed into place, so processes that have the old file mapped
+ * (including this one) keep reading intact weights.
+ */
+bool evalSave(const char *path, const int16_t *stageWeights,
+              const EvalMpcTable *mpc) {
+    string temporary = string(path) + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == nullptr) return false;
+
+    EvalFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EVAL_FILE_MAGIC, sizeof(header.magic));
+    header.version = EVAL_FILE_VERSION;
+    header.stages = EVAL_NUM_STAGES;
+    header.weightsPerStage = EVAL_WEIGHTS_PER_STAGE;
+
+    EvalMpcTable none;
+    if (mpc == nullptr) {
+        memset(&none, 0, sizeof(none));
+        mpc = &none;
+    }
+
+    size_t count = (size_t)EVAL_NUM_STAGES * EVAL_WEIGHTS_PER_STAGE;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(stageWeights, sizeof(int16_t), count, file) == count &&
+              fwrite(mpc, sizeof(EvalMpcTable), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    if (ok) ok = (rename(temporary.c_str(), path) == 0);
+    if (!ok) remove(temporary.c_str());
+    return ok;
+}
+
+/*
+ * The weights in use, EVAL_NUM_STAGES sets back to back. At least two
+ * readable bytes always precede them.
+ */
+const int16_t *evalWeights() {
+    return weights;
+}
+
+/*
+ * Computes every feature index of a board from scratch.
+ */
+void evalFeatures(const Board &board, EvalFeatures *features) {
+    uint64_t black = board.getPieces(BLACK);
+    uint64_t white = board.getPieces(WHITE);
+
+    for (int f = 0; f < EVAL_NUM_FEATURES; f++) {
+        int index = 0;
+        for (int k = featureSize[f] - 1; k >= 0; k--) {
+            int sq = featureSquares[f][k];
+            index = 3 * index + (int)((black >> sq) & 1) +
+                    2 * (int)((white >> sq) & 1);
+        }
+        features->index[f] = index;
+    }
+}
+
+/*
+ * Updates feature indices for `side` playing on `square` and flipping the
+ * discs in `flipped`. Only the features through those squares change.
+ */
+void evalUpdate(EvalFeatures *features, int square, uint64_t flipped,
+                Side side) {
+    int placed = PLACED_DIGIT[side];
+    int flip = FLIP_CHANGE[side];
+
+    for (int i = 0; i < squareFeatureCount[square]; i++) {
+        const SquareFeature &entry = squareFeatures[square][i];
+        features->index[entry.feature] += placed * entry.power;
+    }
+    for (uint64_t b = flipped; b; b &= b - 1) {
+        int sq = firstSquare(b);
+        for (int i = 0; i < squareFeatureCount[sq]; i++) {
+            const SquareFeature &entry = squareFeatures[sq][i];
+            features->index[entry.feature] += flip * entry.power;
+        }
+    }
+}
+
+/*
+ * Game stage used to pick a weight set.
+ */
+int evalStage(int empties) {
+    int stage = (60 - empties) / 6;
+    if (stage < 0) return 0;
+    if (stage >= EVAL_NUM_STAGES) return EVAL_NUM_STAGES - 1;
+    return stage;
+}
+
+/*
+ * Position of a feature's table within a stage's weights.
+ */
+int evalFeatureOffset(int feature) {
+    return featureOffset[feature];
+}
+
+/*
+ * Number of squares of a feature, and its k-th square (digit k of its
+ * index).
+ */
+int evalFeatureSize(int feature) {
+    return featureSize[feature];
+}
+
+int evalFeatureSquare(int feature, int k) {
+    return featureSquares[feature][k];
+}
+
+/*
+ * Score for `side` to move: one table load per feature.
+ */
+int evalScore(const EvalFeatures &features, int empties, Side side) {
+    const int16_t *w = weights +
+        (size_t)evalStage(empties) * EVAL_WEIGHTS_PER_STAGE;
+
+    int score = 0;
+    for (int f = 0; f < EVAL_NUM_FEATURES; f++) {
+        score += w[featureOffset[f] + features.index[f]];
+    }
+
+    if (score > EVAL_LIMIT) score = EVAL_LIMIT;
+    if (score < -EVAL_LIMIT) score = -EVAL_LIMIT;
+    return (side == BLACK) ? score : -score;
+}
+
+/*
+ * Scores a board without incremental features.
+ */
+int evalBoard(const Board &board, Side side) {
+    EvalFeatures features;
+    evalFeatures(board, &features);
+    return evalScore(features, 64 - popCount(board.getTaken()), side);
+}
+
+/*
+ * ProbCut parameters for a search of the given depth with `empties` empty
+ * squares, or null if there are none.
+ */
+const MpcParams *evalMpc(int empties, int depth) {
+    if (mpcTable == nullptr || depth < MPC_MIN_DEPTH || depth > MPC_MAX_DEPTH) {
+        return nullptr;
+    }
+    const MpcParams *params = &mpcTable->params[evalStage(empties)][depth];
+    return (params->sigma > 0) ? params : nullptr;
+}
+
+/*
+ * Depth of the shallow search that predicts a search of the given depth:
+ * about half as deep, with the same parity, since evaluations after our
+ * move and after the opponent's are biased differently.
+ */
+int mpcShallowDepth(int depth) {
+    int shallow = depth / 2;
+    if ((depth - shallow) % 2 != 0) shallow--;
+    return (shallow < 1) ? 1 : shallow;
+}
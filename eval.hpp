@@ -0,0 +1,107 @@
+#ifndef __EVAL_H__
+#define __EVAL_H__
+
+#include <cstdint>
+#include "common.hpp"
+#include "board.hpp"
+
+/*
+ * Pattern evaluation. The board is covered by 46 overlapping lines and
+ * corner/edge regions (features), grouped into 11 pattern shapes whose
+ * symmetric copies share one weight table. A feature's index is its squares
+ * read as a base-3 number (0 empty, 1 black, 2 white), and the evaluation is
+ * the sum of one table entry per feature for the current game stage, from
+ * black's point of view.
+ */
+
+#define EVAL_NUM_PATTERNS 11
+#define EVAL_NUM_FEATURES 46
+#define EVAL_MAX_PATTERN_SIZE 10
+#define EVAL_NUM_STAGES 10
+// Every pattern table of one stage, laid out back to back.
+#define EVAL_WEIGHTS_PER_STAGE 167265
+// Trained weights are in these units per disc of final margin.
+#define EVAL_SCALE 32
+// Evaluations stay clear of SCORE_WIN, which marks finished games.
+#define EVAL_LIMIT 16000
+
+// Weight file Player maps at startup if it exists.
+#define EVAL_WEIGHTS_FILE "heartizach.weights"
+#define EVAL_FILE_MAGIC "HZEVAL\0"
+#define EVAL_FILE_VERSION 2
+
+// Search depths Multi-ProbCut parameters are kept for.
+#define MPC_MIN_DEPTH 3
+#define MPC_MAX_DEPTH 14
+
+/*
+ * Header of a weight file. It is followed by EVAL_NUM_STAGES *
+ * EVAL_WEIGHTS_PER_STAGE int16_t weights, stage by stage, and from version
+ * 2 on by the ProbCut table (EvalMpcTable), all in host byte order.
+ */
+struct EvalFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t stages;
+    uint32_t weightsPerStage;
+    uint32_t reserved;
+};
+
+/*
+ * How a deep search result relates to a shallow one in one stage: the
+ * deep score is about slope * shallow + offset, with errors of standard
+ * deviation sigma. sigma <= 0 marks a pair that has not been calibrated.
+ */
+struct MpcParams {
+    float slope;
+    float offset;
+    float sigma;
+};
+
+struct EvalMpcTable {
+    MpcParams params[EVAL_NUM_STAGES][MPC_MAX_DEPTH + 1];
+};
+
+/*
+ * Feature indices of one position. Search keeps one per ply and updates it
+ * incrementally as moves are made.
+ */
+struct EvalFeatures {
+    uint16_t index[EVAL_NUM_FEATURES];
+};
+
+void evalInit();
+bool evalLoad(const char *path);
+bool evalSave(const char *path, const int16_t *stageWeights,
+              const EvalMpcTable *mpc = nullptr);
+const int16_t *evalWeights();
+void evalFeatures(const Board &board, EvalFeatures *features);
+void evalUpdate(EvalFeatures *features, int square, uint64_t flipped,
+                Side side);
+int evalScore(const EvalFeatures &features, int empties, Side side);
+int evalBoard(const Board &board, Side side);
+
+int evalStage(int empties);
+int evalFeatureOffset(int feature);
+int evalFeatureSize(int feature);
+int evalFeatureSquare(int feature, int k);
+
+/*
+ * Batch evaluation: scores many positions given as parallel arrays of
+ * bitboards, recomputing every feature index, with the fastest kernel the
+ * CPU supports.
+ */
+enum EvalKernel {
+    EVAL_KERNEL_SCALAR, EVAL_KERNEL_SSE2, EVAL_KERNEL_AVX2
+};
+
+void evalBatch(const uint64_t *black, const uint64_t *white,
+               const Side *toMove, int count, int *scores);
+EvalKernel evalBatchKernel();
+bool evalSetBatchKernel(EvalKernel kernel);
+const char *evalKernelName(EvalKernel kernel);
+
+const MpcParams *evalMpc(int empties, int depth);
+int mpcShallowDepth(int depth);
+
+#endif
@@ -0,0 +1,244 @@
+#include <atomic>
+#include <mutex>
+#include "eval.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define EVAL_BATCH_X86
+#endif
+
+using namespace std;
+
+/*
+ * Batch evaluation. Search scores its leaves from feature indices it updates
+ * move by move; unrelated positions (a benchmark set, an analysis queue, a
+ * training corpus) have to be scored from their bitboards, which is work
+ * that vectorizes. The SIMD kernels build the base-3 index of one feature
+ * for several positions at once, one digit per step, in 64-bit lanes, and
+ * load the table entries of all of them together. Whatever is left over
+ * after the last full group goes through the scalar kernel, and all of them
+ * give exactly evalBoard's scores.
+ */
+
+/*
+ * A feature as the kernels use it: its squares from the highest digit down,
+ * and its table's position within a stage.
+ */
+struct BatchFeature {
+    int size;
+    int offset;
+    int squares[EVAL_MAX_PATTERN_SIZE];
+};
+
+static BatchFeature features[EVAL_NUM_FEATURES];
+static atomic<int> kernel(EVAL_KERNEL_SCALAR);
+static once_flag batchFlag;
+
+static bool kernelSupported(EvalKernel k) {
+    switch (k) {
+    case EVAL_KERNEL_SCALAR:
+        return true;
+#ifdef EVAL_BATCH_X86
+    case EVAL_KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case EVAL_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+static void batchInitOnce() {
+    evalInit();
+    for (int f = 0; f < EVAL_NUM_FEATURES; f++) {
+        int size = evalFeatureSize(f);
+        features[f].size = size;
+        features[f].offset = evalFeatureOffset(f);
+        for (int k = 0; k < size; k++) {
+            features[f].squares[k] = evalFeatureSquare(f, size - 1 - k);
+        }
+    }
+
+    // The fastest kernel this CPU runs.
+    if (kernelSupported(EVAL_KERNEL_AVX2)) kernel = EVAL_KERNEL_AVX2;
+    else if (kernelSupported(EVAL_KERNEL_SSE2)) kernel = EVAL_KERNEL_SSE2;
+    else kernel = EVAL_KERNEL_SCALAR;
+}
+
+static void batchInit() {
+    call_once(batchFlag, batchInitOnce);
+}
+
+/*
+ * Start of the weights for a position's stage, relative to evalWeights().
+ */
+static int stageBase(uint64_t black, uint64_t white) {
+    return evalStage(64 - popCount(black | white)) * EVAL_WEIGHTS_PER_STAGE;
+}
+
+/*
+ * Raw sums (black's point of view, unclamped) of `count` positions.
+ */
+static void scalarKernel(const uint64_t *black, const uint64_t *white,
+                         int count, const int16_t *weights, int *sums) {
+    for (int i = 0; i < count; i++) {
+        const int16_t *w = weights + stageBase(black[i], white[i]);
+        int sum = 0;
+        for (int f = 0; f < EVAL_NUM_FEATURES; f++) {
+            const BatchFeature &feature = features[f];
+            int index = 0;
+            for (int k = 0; k < feature.size; k++) {
+                int sq = feature.squares[k];
+                index = 3 * index + (int)((black[i] >> sq) & 1) +
+                        2 * (int)((white[i] >> sq) & 1);
+            }
+            sum += w[feature.offset + index];
+        }
+        sums[i] = sum;
+    }
+}
+
+#ifdef EVAL_BATCH_X86
+
+/*
+ * Two positions per step. SSE2 has no gather, so the two indices are
+ * moved out and looked up one at a time.
+ */
+static void sse2Kernel(const uint64_t *black, const uint64_t *white,
+                       int count, const int16_t *weights, int *sums) {
+    const __m128i one = _mm_set1_epi64x(1);
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128i b = _mm_loadu_si128((const __m128i *)(black + i));
+        __m128i w = _mm_loadu_si128((const __m128i *)(white + i));
+        const int16_t *w0 = weights + stageBase(black[i], white[i]);
+        const int16_t *w1 = weights + stageBase(black[i + 1], white[i + 1]);
+
+        int sum0 = 0, sum1 = 0;
+        for (int f = 0; f < EVAL_NUM_FEATURES; f++) {
+            const BatchFeature &feature = features[f];
+            __m128i index = _mm_setzero_si128();
+            for (int k = 0; k < feature.size; k++) {
+                __m128i shift = _mm_cvtsi32_si128(feature.squares[k]);
+                __m128i digit = _mm_add_epi64(
+                    _mm_and_si128(_mm_srl_epi64(b, shift), one),
+                    _mm_slli_epi64(_mm_and_si128(_mm_srl_epi64(w, shift), one),
+                                   1));
+                index = _mm_add_epi64(
+                    _mm_add_epi64(index, _mm_slli_epi64(index, 1)), digit);
+            }
+            sum0 += w0[feature.offset + _mm_cvtsi128_si32(index)];
+            sum1 += w1[feature.offset +
+                       _mm_cvtsi128_si32(_mm_unpackhi_epi64(index, index))];
+        }
+        sums[i] = sum0;
+        sums[i + 1] = sum1;
+    }
+    scalarKernel(black + i, white + i, count - i, weights, sums + i);
+}
+
+/*
+ * Four positions per step, with one gather per feature. The gather reads
+ * 32 bits ending at each weight, which puts the weight in the high half
+ * for a sign-extending shift; evalWeights guarantees the bytes before it.
+ */
+__attribute__((target("avx2")))
+static void avx2Kernel(const uint64_t *black, const uint64_t *white,
+                       int count, const int16_t *weights, int *sums) {
+    const __m256i one = _mm256_set1_epi64x(1);
+    const int *base = (const int *)(weights - 1);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i b = _mm256_loadu_si256((const __m256i *)(black + i));
+        __m256i w = _mm256_loadu_si256((const __m256i *)(white + i));
+        __m256i stage = _mm256_set_epi64x(
+            stageBase(black[i + 3], white[i + 3]),
+            stageBase(black[i + 2], white[i + 2]),
+            stageBase(black[i + 1], white[i + 1]),
+            stageBase(black[i], white[i]));
+
+        __m128i sum = _mm_setzero_si128();
+        for (int f = 0; f < EVAL_NUM_FEATURES; f++) {
+            const BatchFeature &feature = features[f];
+            __m256i index = _mm256_setzero_si256();
+            for (int k = 0; k < feature.size; k++) {
+                __m128i shift = _mm_cvtsi32_si128(feature.squares[k]);
+                __m256i digit = _mm256_add_epi64(
+                    _mm256_and_si256(_mm256_srl_epi64(b, shift), one),
+                    _mm256_slli_epi64(
+                        _mm256_and_si256(_mm256_srl_epi64(w, shift), one), 1));
+                index = _mm256_add_epi64(
+                    _mm256_add_epi64(index, _mm256_slli_epi64(index, 1)),
+                    digit);
+            }
+            index = _mm256_add_epi64(
+                index, _mm256_add_epi64(stage,
+                                        _mm256_set1_epi64x(feature.offset)));
+            __m128i entries = _mm256_i64gather_epi32(base, index, 2);
+            sum = _mm_add_epi32(sum, _mm_srai_epi32(entries, 16));
+        }
+        _mm_storeu_si128((__m128i *)(sums + i), sum);
+    }
+    scalarKernel(black + i, white + i, count - i, weights, sums + i);
+}
+
+#endif
+
+/*
+ * Scores `count` positions, given as parallel arrays, for their side to
+ * move; scores[i] is what evalBoard would return for position i.
+ */
+void evalBatch(const uint64_t *black, const uint64_t *white,
+               const Side *toMove, int count, int *scores) {
+    batchInit();
+    const int16_t *weights = evalWeights();
+
+    switch (kernel.load(memory_order_relaxed)) {
+#ifdef EVAL_BATCH_X86
+    case EVAL_KERNEL_AVX2:
+        avx2Kernel(black, white, count, weights, scores);
+        break;
+    case EVAL_KERNEL_SSE2:
+        sse2Kernel(black, white, count, weights, scores);
+        break;
+#endif
+    default:
+        scalarKernel(black, white, count, weights, scores);
+        break;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int score = scores[i];
+        if (score > EVAL_LIMIT) score = EVAL_LIMIT;
+        if (score < -EVAL_LIMIT) score = -EVAL_LIMIT;
+        scores[i] = (toMove[i] == BLACK) ? score : -score;
+    }
+}
+
+/*
+ * The kernel evalBatch uses.
+ */
+EvalKernel evalBatchKernel() {
+    batchInit();
+    return (EvalKernel)kernel.load();
+}
+
+/*
+ * Makes evalBatch use the given kernel, for benchmarks and checks. Returns
+ * false, changing nothing, if this CPU or build can't run it.
+ */
+bool evalSetBatchKernel(EvalKernel k) {
+    batchInit();
+    if (!kernelSupported(k)) return false;
+    kernel = k;
+    return true;
+}
+
+const char *evalKernelName(EvalKernel k) {
+    switch (k) {
+    case EVAL_KERNEL_SSE2: return "sse2";
+    case EVAL_KERNEL_AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
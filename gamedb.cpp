@@ -0,0 +1,196 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "gamedb.hpp"
+
+using namespace std;
+
+/*
+ * Starts an empty record.
+ */
+void gameClear(GameRecord *game) {
+    memset(game, 0, sizeof(*game));
+}
+
+/*
+ * Adds a move; passes (negative squares) are implied and not stored.
+ * Returns false if the record is full.
+ */
+bool gamePush(GameRecord *game, int sq) {
+    if (sq < 0) return true;
+    if (game->numMoves >= GAMEDB_MAX_MOVES) return false;
+    game->moves[game->numMoves++] = (uint8_t)sq;
+    return true;
+}
+
+/*
+ * Stores the result of the board where play stopped, marking the game
+ * unfinished if either side could still move.
+ */
+void gameFinish(GameRecord *game, const Board &board, int flags) {
+    game->result = (int8_t)(popCount(board.getPieces(BLACK)) -
+                            popCount(board.getPieces(WHITE)));
+    if (board.generateMoves(BLACK) | board.generateMoves(WHITE)) {
+        flags |= GAME_UNFINISHED;
+    }
+    game->flags = (uint8_t)flags;
+}
+
+/*
+ * Plays sq for *side, or for the opponent if *side has to pass, and leaves
+ * the other side to move. Returns false, changing nothing, if the move is
+ * illegal for the player whose turn it is.
+ */
+bool gamePlay(Board *board, Side *side, int sq) {
+    if (sq < 0 || sq >= 64) return false;
+    Side mover = *side;
+    uint64_t moves = board->generateMoves(mover);
+    if (moves == 0) {
+        mover = opponent(mover);
+        moves = board->generateMoves(mover);
+    }
+    if (((moves >> sq) & 1) == 0) return false;
+
+    board->makeMove(sq, mover);
+    *side = opponent(mover);
+    return true;
+}
+
+/*
+ * Sets up the standard start and plays the first `plies` moves of a game
+ * (all of them if plies is negative). Returns how many were played, which
+ * is fewer if the record holds an illegal move.
+ */
+int gameReplay(const GameRecord &game, Board *board, Side *side, int plies) {
+    *board = Board();
+    *side = BLACK;
+    int length = game.numMoves;
+    if (length > GAMEDB_MAX_MOVES) length = GAMEDB_MAX_MOVES;
+    if (plies >= 0 && plies < length) length = plies;
+
+    for (int i = 0; i < length; i++) {
+        if (!gamePlay(board, side, game.moves[i])) return i;
+    }
+    return length;
+}
+
+GameWriter::GameWriter() {
+    fd = -1;
+}
+
+GameWriter::~GameWriter() {
+    close();
+}
+
+/*
+ * Opens a game file for appending. A new or empty file gets its header
+ * first, under a lock so that two writers starting together write one, and
+ * a partial record left by a crash is cut off so the next one lines up.
+ * Returns false if the file can't be opened or isn't a game file.
+ */
+bool GameWriter::open(const char *path) {
+    close();
+    int file = ::open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (file < 0) return false;
+
+    bool ok = (flock(file, LOCK_EX) == 0);
+    struct stat st;
+    ok = ok && fstat(file, &st) == 0;
+    if (ok && st.st_size == 0) {
+        GameFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, GAMEDB_FILE_MAGIC, sizeof(header.magic));
+        header.version = GAMEDB_FILE_VERSION;
+        header.recordSize = sizeof(GameRecord);
+        ok = write(file, &header, sizeof(header)) == sizeof(header);
+    } else if (ok) {
+        GameFileHeader header;
+        ok = pread(file, &header, sizeof(header), 0) == sizeof(header) &&
+             memcmp(header.magic, GAMEDB_FILE_MAGIC,
+                    sizeof(header.magic)) == 0 &&
+             header.version == GAMEDB_FILE_VERSION &&
+             header.recordSize == sizeof(GameRecord);
+        size_t tail = (st.st_size - sizeof(header)) % sizeof(GameRecord);
+        if (ok && tail != 0) ok = ftruncate(file, st.st_size - tail) == 0;
+    }
+    flock(file, LOCK_UN);
+
+    if (!ok) {
+        ::close(file);
+        return false;
+    }
+    fd = file;
+    return true;
+}
+
+/*
+ * Appends one game. The record goes out in one write to an O_APPEND file,
+ * so writers sharing the file never interleave within a record.
+ */
+bool GameWriter::append(const GameRecord &game) {
+    if (fd < 0) return false;
+    ssize_t written;
+    do {
+        written = write(fd, &game, sizeof(game));
+    } while (written < 0 && errno == EINTR);
+    return written == (ssize_t)sizeof(game);
+}
+
+void GameWriter::close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+GameDatabase::GameDatabase() {
+    map = nullptr;
+    mapSize = 0;
+    games = nullptr;
+    count = 0;
+}
+
+GameDatabase::~GameDatabase() {
+    if (map != nullptr) munmap(map, mapSize);
+}
+
+/*
+ * Memory-maps a game file. Pages are read in as the games are visited, so
+ * loading costs nothing up front. A partial record at the end, from a
+ * writer that died mid-append, is left out. Returns false, leaving the
+ * database empty, if the file is missing or malformed.
+ */
+bool GameDatabase::load(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GameFileHeader)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    const GameFileHeader *header = (const GameFileHeader *)mapped;
+    if (memcmp(header->magic, GAMEDB_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != GAMEDB_FILE_VERSION ||
+        header->recordSize != sizeof(GameRecord)) {
+        munmap(mapped, size);
+        return false;
+    }
+    // Sequential scans are the common case.
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    if (map != nullptr) munmap(map, mapSize);
+    map = mapped;
+    mapSize = size;
+    games = (const GameRecord *)(header + 1);
+    count = (size - sizeof(GameFileHeader)) / sizeof(GameRecord);
+    return true;
+}
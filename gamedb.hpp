@@ -0,0 +1,96 @@
+#ifndef __GAMEDB_H__
+#define __GAMEDB_H__
+
+#include <cstddef>
+#include <cstdint>
+#include "common.hpp"
+#include "board.hpp"
+
+/*
+ * Game records. A game file is a header followed by fixed-size GameRecord
+ * entries, one per game, in host byte order. Games are only ever appended,
+ * each with a single write, so several writers (arena's threads, or the
+ * wrapper processes of several matches) can share a file; a record cut
+ * short by a crash is ignored by the reader. Reading maps the file and
+ * hands out records in place, so a scan of millions of games copies
+ * nothing.
+ *
+ * A game starts from the standard position with black to move. Only moves
+ * are stored: a pass is implied whenever the side to move has no legal
+ * move, and gamePlay follows that rule when replaying.
+ */
+
+#define GAMEDB_FILE_MAGIC "HZGAMES"
+#define GAMEDB_FILE_VERSION 1
+// A game fills at most the 60 empty squares of the start.
+#define GAMEDB_MAX_MOVES 60
+
+// GameRecord::flags
+// Recording stopped before the game was over.
+#define GAME_UNFINISHED 1
+// That side lost on time or by an illegal move.
+#define GAME_BLACK_FORFEIT 2
+#define GAME_WHITE_FORFEIT 4
+
+struct GameFileHeader {
+    char magic[8];
+    uint32_t version;
+    // sizeof(GameRecord) of the writer.
+    uint32_t recordSize;
+};
+
+struct GameRecord {
+    // Squares played, x + 8*y, in order; numMoves of them are used.
+    uint8_t moves[GAMEDB_MAX_MOVES];
+    uint8_t numMoves;
+    // Black discs minus white discs where play stopped.
+    int8_t result;
+    uint8_t flags;
+    uint8_t reserved;
+};
+
+void gameClear(GameRecord *game);
+bool gamePush(GameRecord *game, int sq);
+void gameFinish(GameRecord *game, const Board &board, int flags);
+bool gamePlay(Board *board, Side *side, int sq);
+int gameReplay(const GameRecord &game, Board *board, Side *side, int plies);
+
+/*
+ * Appends records to a game file, creating it if needed.
+ */
+class GameWriter {
+
+public:
+    GameWriter();
+    ~GameWriter();
+
+    bool open(const char *path);
+    bool append(const GameRecord &game);
+    void close();
+    bool isOpen() const { return fd >= 0; }
+
+private:
+    int fd;
+};
+
+/*
+ * Read-only mapping of a game file.
+ */
+class GameDatabase {
+
+public:
+    GameDatabase();
+    ~GameDatabase();
+
+    bool load(const char *path);
+    size_t getSize() const { return count; }
+    const GameRecord &getGame(size_t i) const { return games[i]; }
+
+private:
+    void *map;
+    size_t mapSize;
+    const GameRecord *games;
+    size_t count;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "gamedb.hpp"
+
+using namespace std;
+
+/*
+ * Turns a game file into a corpus for train, calibrate and analyze: every
+ * position of every finished game, one per line, as
+ *
+ *   <64 squares, row by row: 'b', 'w' or '-'> <b|w> <score>
+ *
+ * where the letter is the side to move and score is black's final disc
+ * count minus white's.
+ *
+ *   gamedump game-file [-a]
+ *
+ * Unfinished and forfeited games have no real result and are skipped
+ * unless -a is given.
+ */
+
+static void printPosition(const Board &board, Side side, int result) {
+    char line[72];
+    uint64_t black = board.getPieces(BLACK);
+    uint64_t white = board.getPieces(WHITE);
+    for (int sq = 0; sq < 64; sq++) {
+        line[sq] = ((black >> sq) & 1) ? 'b' : ((white >> sq) & 1) ? 'w' : '-';
+    }
+    line[64] = ' ';
+    line[65] = (side == BLACK) ? 'b' : 'w';
+    line[66] = '\0';
+    printf("%s %d\n", line, result);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s game-file [-a]\n", name);
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) usage(argv[0]);
+    bool all = false;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "-a")) all = true;
+        else usage(argv[0]);
+    }
+
+    GameDatabase games;
+    if (!games.load(argv[1])) {
+        fprintf(stderr, "can't read games from %s\n", argv[1]);
+        return 1;
+    }
+
+    size_t dumped = 0, skipped = 0, broken = 0;
+    for (size_t g = 0; g < games.getSize(); g++) {
+        const GameRecord &game = games.getGame(g);
+        if (game.flags != 0 && !all) {
+            skipped++;
+            continue;
+        }
+
+        Board board;
+        Side side = BLACK;
+        for (int i = 0; i < game.numMoves && i < GAMEDB_MAX_MOVES; i++) {
+            // The position is printed with the side that actually moves.
+            Side mover = side;
+            if (board.generateMoves(mover) == 0) mover = opponent(mover);
+            printPosition(board, mover, game.result);
+            if (!gamePlay(&board, &side, game.moves[i])) {
+                broken++;
+                break;
+            }
+        }
+        dumped++;
+    }
+
+    fprintf(stderr, "dumped %zu games, skipped %zu", dumped, skipped);
+    if (broken > 0) fprintf(stderr, ", %zu with illegal moves", broken);
+    fprintf(stderr, "\n");
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "learn.hpp"
+
+using namespace std;
+
+// Depth an exact result counts as when choosing what to keep.
+static const int EXACT_DEPTH = 64;
+// Depth an entry loses for every game it goes unused.
+static const int AGE_PENALTY = 2;
+
+/*
+ * How much an entry is worth keeping after `games` saves: deep results
+ * first, and among those the ones used lately.
+ */
+static int keepValue(const LearnedEntry &entry, uint32_t games) {
+    int depth = entry.exact ? EXACT_DEPTH : entry.depth;
+    return depth - AGE_PENALTY * (int)(games - entry.lastUsed);
+}
+
+/*
+ * True if a should replace b as the result for their position.
+ */
+static bool better(const LearnedEntry &a, const LearnedEntry &b) {
+    if (a.exact != b.exact) return a.exact;
+    if (a.depth != b.depth) return a.depth > b.depth;
+    return a.lastUsed >= b.lastUsed;
+}
+
+LearnedCache::LearnedCache() {
+    games = 0;
+}
+
+uint64_t LearnedCache::entryKey(const LearnedEntry &entry) {
+    Board board;
+    board.setPieces(entry.black, entry.white);
+    return board.getCanonicalHash((Side)entry.toMove, nullptr);
+}
+
+/*
+ * Adds an entry, or keeps the better of it and the one already stored for
+ * its position.
+ */
+void LearnedCache::merge(const LearnedEntry &entry) {
+    uint64_t key = entryKey(entry);
+    unordered_map<uint64_t, size_t>::iterator found = index.find(key);
+    if (found == index.end()) {
+        index[key] = entries.size();
+        entries.push_back(entry);
+        return;
+    }
+
+    LearnedEntry &old = entries[found->second];
+    uint32_t lastUsed = max(old.lastUsed, entry.lastUsed);
+    if (better(entry, old)) old = entry;
+    old.lastUsed = lastUsed;
+}
+
+/*
+ * Reads a file written by save. Returns false, leaving the cache empty, if
+ * the file is missing or malformed, including a count that doesn't match
+ * the file's size, which is checked before anything is allocated.
+ */
+bool LearnedCache::load(const char *path) {
+    entries.clear();
+    index.clear();
+    games = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) return false;
+
+    LearnedFileHeader header;
+    vector<LearnedEntry> stored;
+    struct stat st;
+    bool ok = fstat(fileno(file), &st) == 0 &&
+              fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, LEARN_FILE_MAGIC,
+                     sizeof(header.magic)) == 0 &&
+              header.version == LEARN_FILE_VERSION &&
+              (uint64_t)st.st_size == sizeof(header) +
+                  (uint64_t)header.count * sizeof(LearnedEntry);
+    if (ok) {
+        stored.resize(header.count);
+        ok = fread(stored.data(), sizeof(LearnedEntry), header.count, file) ==
+             header.count;
+    }
+    fclose(file);
+    if (!ok) return false;
+
+    games = header.games;
+    for (size_t i = 0; i < stored.size(); i++) {
+        const LearnedEntry &entry = stored[i];
+        if ((entry.black & entry.white) || entry.toMove > BLACK ||
+            entry.move >= 64) {
+            continue;
+        }
+        merge(entry);
+    }
+    return true;
+}
+
+/*
+ * Keeps the result of a search or exact solve of `side` to move, unless it
+ * is too shallow to be worth it.
+ */
+void LearnedCache::record(const Board &board, Side side, int depth,
+                          int score, int move, bool exact) {
+    if (move < 0 || move >= 64) return;
+    if (!exact && depth < LEARN_MIN_DEPTH) return;
+
+    LearnedEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    int symmetry = board.canonicalForm(&entry.black, &entry.white);
+    entry.lastUsed = games + 1;
+    entry.score = (int16_t)score;
+    entry.depth = (uint8_t)depth;
+    entry.exact = exact;
+    entry.toMove = side;
+    entry.move = transformSquare(move, symmetry);
+    merge(entry);
+}
+
+/*
+ * Marks the entry for a position met in play as used by this game.
+ * Returns false if there is none.
+ */
+bool LearnedCache::touch(const Board &board, Side side) {
+    unordered_map<uint64_t, size_t>::iterator found =
+        index.find(board.getCanonicalHash(side, nullptr));
+    if (found == index.end()) return false;
+    entries[found->second].lastUsed = games + 1;
+    return true;
+}
+
+/*
+ * Merges these entries into whatever the file holds now (another process
+ * may have saved since this one loaded), keeps the best `capacity` of
+ * them, and replaces the file. The new contents go to a temporary file
+ * that is synced and then renamed into place, so readers and a crash at
+ * any point see either the old file or the new one. Saves to one path are
+ * serialised by a lock on path.lock. Afterwards this cache holds what was
+ * written.
+ */
+bool LearnedCache::save(const char *path, size_t capacity) {
+    string lockPath = string(path) + ".lock";
+    int lock = open(lockPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (lock < 0) return false;
+    flock(lock, LOCK_EX);
+
+    LearnedCache merged;
+    merged.load(path);
+    for (size_t i = 0; i < entries.size(); i++) {
+        merged.merge(entries[i]);
+    }
+    uint32_t saves = max(merged.games, games) + 1;
+
+    vector<LearnedEntry> &kept = merged.entries;
+    if (kept.size() > capacity) {
+        vector<pair<int, size_t> > ranked;
+        for (size_t i = 0; i < kept.size(); i++) {
+            ranked.push_back(make_pair(-keepValue(kept[i], saves), i));
+        }
+        sort(ranked.begin(), ranked.end());
+        vector<LearnedEntry> best;
+        for (size_t i = 0; i < capacity; i++) {
+            best.push_back(kept[ranked[i].second]);
+        }
+        kept.swap(best);
+    }
+
+    LearnedFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LEARN_FILE_MAGIC, sizeof(header.magic));
+    header.version = LEARN_FILE_VERSION;
+    header.count = kept.size();
+    header.games = saves;
+
+    string tempPath = string(path) + ".tmp";
+    FILE *file = fopen(tempPath.c_str(), "wb");
+    bool ok = file != nullptr;
+    if (ok) {
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(kept.data(), sizeof(LearnedEntry), kept.size(), file) ==
+                 kept.size() &&
+             fflush(file) == 0 && fsync(fileno(file)) == 0;
+        ok = (fclose(file) == 0) && ok;
+    }
+    ok = ok && rename(tempPath.c_str(), path) == 0;
+    if (!ok) unlink(tempPath.c_str());
+
+    flock(lock, LOCK_UN);
+    close(lock);
+    if (!ok) return false;
+
+    entries.swap(kept);
+    index.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+        index[entryKey(entries[i])] = i;
+    }
+    games = saves;
+    return true;
+}
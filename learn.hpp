@@ -0,0 +1,89 @@
+#ifndef __LEARN_H__
+#define __LEARN_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "common.hpp"
+#include "board.hpp"
+
+/*
+ * Results kept from game to game. Player records the outcome of every deep
+ * search and exact solve of a game, saves them when the game ends, and a
+ * later game preloads them into its tables, so a line that went wrong is
+ * not re-analysed from nothing.
+ *
+ * Positions are stored in canonical orientation (Board::canonicalForm), so
+ * one entry serves all 8 orientations whatever keys the tables use. The
+ * store is bounded: when it is full, the entries kept are the deepest and
+ * most recently used (see LearnedCache::save). It is written to a temporary
+ * file and renamed over the old one, so a crash leaves the old file whole.
+ */
+
+#define LEARN_FILE_MAGIC "HZLEARN"
+#define LEARN_FILE_VERSION 1
+// Entries kept by default; 2 MB of file.
+#define LEARN_DEFAULT_ENTRIES 65536
+// Shallower searches are not worth keeping.
+#define LEARN_MIN_DEPTH 8
+// Before each search, kept results for positions up to this many empties
+// ahead are stored in the tables again.
+#define LEARN_PRIME_EMPTIES 12
+
+struct LearnedFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    // Saves so far, which is the clock lastUsed counts in.
+    uint32_t games;
+    uint32_t reserved;
+};
+
+/*
+ * One position. It is followed in the file by the next with no padding.
+ */
+struct LearnedEntry {
+    // Discs in canonical orientation.
+    uint64_t black;
+    uint64_t white;
+    // Value of LearnedFileHeader::games when the entry was last recorded
+    // or met in play.
+    uint32_t lastUsed;
+    // Search score in evaluation units, or the exact disc differential.
+    int16_t score;
+    // Search depth; the empties for an exact result.
+    uint8_t depth;
+    uint8_t exact;
+    uint8_t toMove;
+    // Best move, in canonical orientation.
+    uint8_t move;
+    uint8_t reserved[6];
+};
+
+class LearnedCache {
+
+public:
+    LearnedCache();
+
+    bool load(const char *path);
+    bool save(const char *path, size_t capacity = LEARN_DEFAULT_ENTRIES);
+    void record(const Board &board, Side side, int depth, int score, int move,
+                bool exact);
+    bool touch(const Board &board, Side side);
+
+    size_t getSize() const { return entries.size(); }
+    const LearnedEntry &getEntry(size_t i) const { return entries[i]; }
+
+private:
+    void merge(const LearnedEntry &entry);
+    static uint64_t entryKey(const LearnedEntry &entry);
+
+    std::vector<LearnedEntry> entries;
+    // Position key of each entry to its index.
+    std::unordered_map<uint64_t, size_t> index;
+    // Saves of the file this was loaded from.
+    uint32_t games;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "book.hpp"
+#include "search.hpp"
+
+using namespace std;
+
+/*
+ * Builds the opening book. Every distinct position (up to symmetry) within
+ * the given number of plies of the start is searched to a fixed depth, and
+ * the move the search chooses goes into the book. Positions are expanded a
+ * ply at a time and each level is searched in parallel against one shared
+ * transposition table.
+ *
+ *   mkbook [-o book] [-p plies] [-d depth] [-t threads] [-h tt-megabytes]
+ */
+
+struct BookPosition {
+    Board board;
+    Side toMove;
+};
+
+static vector<BookPosition> level;
+static vector<BookEntry> entries;
+static vector<BookEntry> levelEntries;
+static atomic<size_t> nextPosition(0);
+static int searchDepth = 12;
+
+static void worker(TranspositionTable *table) {
+    Search search;
+    search.setTable(table);
+
+    for (size_t i = nextPosition++; i < level.size(); i = nextPosition++) {
+        const BookPosition &position = level[i];
+        int sq = search.run(position.board, position.toMove, searchDepth, -1);
+
+        int symmetry;
+        BookEntry &entry = levelEntries[i];
+        entry.key = position.board.getCanonicalHash(position.toMove, &symmetry);
+        entry.score = search.getScore();
+        entry.depth = search.getDepth();
+        entry.move = transformSquare(sq, symmetry);
+        entry.reserved = 0;
+    }
+}
+
+/*
+ * Every position one ply on from the current level that hasn't been seen.
+ * A side without a move passes.
+ */
+static vector<BookPosition> expand(unordered_set<uint64_t> &seen) {
+    vector<BookPosition> next;
+    for (size_t i = 0; i < level.size(); i++) {
+        const BookPosition &position = level[i];
+        Side other = opponent(position.toMove);
+
+        uint64_t moves = position.board.generateMoves(position.toMove);
+        while (moves) {
+            BookPosition child;
+            child.board = position.board.apply(firstSquare(moves),
+                                               position.toMove);
+            child.toMove = other;
+            moves &= moves - 1;
+
+            if (!child.board.generateMoves(other)) {
+                if (!child.board.generateMoves(position.toMove)) continue;
+                child.toMove = position.toMove;
+            }
+            uint64_t key = child.board.getCanonicalHash(child.toMove, nullptr);
+            if (seen.insert(key).second) {
+                next.push_back(child);
+            }
+        }
+    }
+    return next;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-o book] [-p plies] [-d depth] [-t threads] "
+                    "[-h tt-megabytes]\n", name);
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *output = BOOK_FILE;
+    int plies = 6;
+    int threads = thread::hardware_concurrency();
+    size_t ttMegabytes = 256;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) usage(argv[0]);
+        if (!strcmp(argv[i], "-o")) output = argv[++i];
+        else if (!strcmp(argv[i], "-p")) plies = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-d")) searchDepth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-t")) threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-h")) ttMegabytes = atoi(argv[++i]);
+        else usage(argv[0]);
+    }
+    if (threads < 1) threads = 1;
+
+    TranspositionTable table(ttMegabytes);
+    unordered_set<uint64_t> seen;
+
+    BookPosition start;
+    start.toMove = BLACK;
+    level.push_back(start);
+    seen.insert(start.board.getCanonicalHash(start.toMove, nullptr));
+
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for (int ply = 0; ply < plies && !level.empty(); ply++) {
+        table.newSearch();
+        levelEntries.assign(level.size(), BookEntry());
+        nextPosition = 0;
+
+        vector<thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.push_back(thread(worker, &table));
+        }
+        for (int t = 0; t < threads; t++) {
+            workers[t].join();
+        }
+        entries.insert(entries.end(), levelEntries.begin(), levelEntries.end());
+
+        double seconds = chrono::duration<double>(
+            chrono::steady_clock::now() - begin).count();
+        fprintf(stderr, "ply %d: %d positions, %d in book, %.1f s\n", ply,
+                (int)level.size(), (int)entries.size(), seconds);
+
+        if (ply + 1 < plies) level = expand(seen);
+    }
+
+    if (!bookSave(output, entries)) {
+        fprintf(stderr, "could not write %s\n", output);
+        return 1;
+    }
+    printf("wrote %d positions to %s\n", (int)entries.size(), output);
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <cstring>
+#include "ordering.hpp"
+
+using namespace std;
+
+// Sort keys of the moves that go first whatever else is known.
+static const int HASH_MOVE_KEY = 1 << 30;
+static const int KILLER_KEY[2] = {1 << 29, 1 << 28};
+// History scores are halved once any of them reaches this.
+static const int HISTORY_MAX = 1 << 16;
+// Weight of a square's HEURISTIC value, and of each opponent reply.
+static const int PRIOR_WEIGHT = 16;
+static const int MOBILITY_WEIGHT = 1 << 12;
+
+static const int NO_KILLER = -1;
+
+MoveOrder::MoveOrder() {
+    clear();
+}
+
+/*
+ * Forgets everything learned, and resets the statistics.
+ */
+void MoveOrder::clear() {
+    for (int ply = 0; ply < ORDER_MAX_PLY; ply++) {
+        killers[ply][0] = NO_KILLER;
+        killers[ply][1] = NO_KILLER;
+    }
+    memset(history, 0, sizeof(history));
+    cutoffs = 0;
+    firstCutoffs = 0;
+}
+
+/*
+ * Called when a new search starts. Killers belong to the old root's plies;
+ * history is still a good guide, at half weight.
+ */
+void MoveOrder::newSearch() {
+    for (int ply = 0; ply < ORDER_MAX_PLY; ply++) {
+        killers[ply][0] = NO_KILLER;
+        killers[ply][1] = NO_KILLER;
+    }
+    for (int side = 0; side < 2; side++) {
+        for (int sq = 0; sq < 64; sq++) {
+            history[side][sq] /= 2;
+        }
+    }
+    cutoffs = 0;
+    firstCutoffs = 0;
+}
+
+/*
+ * Writes the squares of `moves` to out in search order and returns how many
+ * there are. hashMove may be TT_NO_MOVE or any square; it only counts if it
+ * is in moves.
+ */
+int MoveOrder::order(const Board &board, Side side, uint64_t moves,
+                     int hashMove, int ply, int depth, int *out) {
+    if (ply >= ORDER_MAX_PLY) ply = ORDER_MAX_PLY - 1;
+    Side other = opponent(side);
+    uint64_t own = board.getPieces(side);
+    uint64_t opp = board.getPieces(other);
+    bool fastestFirst = (depth >= ORDER_FASTEST_FIRST_DEPTH);
+
+    int keys[NUM_OTHELLO_SQUARES * NUM_OTHELLO_SQUARES];
+    int n = 0;
+    while (moves) {
+        int sq = firstSquare(moves);
+        moves &= moves - 1;
+
+        int key;
+        if (sq == hashMove) {
+            key = HASH_MOVE_KEY;
+        } else if (sq == killers[ply][0]) {
+            key = KILLER_KEY[0];
+        } else if (sq == killers[ply][1]) {
+            key = KILLER_KEY[1];
+        } else {
+            key = history[side][sq] +
+                  PRIOR_WEIGHT * HEURISTIC[sq % NUM_OTHELLO_SQUARES]
+                                          [sq / NUM_OTHELLO_SQUARES];
+            if (fastestFirst) {
+                uint64_t flipped = discFlips(sq, own, opp);
+                uint64_t replies = legalMoves(opp ^ flipped,
+                                              own | flipped | (1ULL << sq));
+                key -= MOBILITY_WEIGHT * popCount(replies);
+            }
+        }
+
+        // Insertion sort, highest key first.
+        int i = n++;
+        while (i > 0 && keys[i - 1] < key) {
+            keys[i] = keys[i - 1];
+            out[i] = out[i - 1];
+            i--;
+        }
+        keys[i] = key;
+        out[i] = sq;
+    }
+    return n;
+}
+
+/*
+ * Records that sq, the moveNumber-th move searched (from 0), caused a beta
+ * cutoff with the given depth left.
+ */
+void MoveOrder::cutoff(Side side, int sq, int ply, int depth,
+                       int moveNumber) {
+    if (ply >= ORDER_MAX_PLY) ply = ORDER_MAX_PLY - 1;
+    cutoffs++;
+    if (moveNumber == 0) firstCutoffs++;
+
+    if (killers[ply][0] != sq) {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = sq;
+    }
+
+    history[side][sq] += depth * depth;
+    if (history[side][sq] >= HISTORY_MAX) {
+        for (int s = 0; s < 2; s++) {
+            for (int i = 0; i < 64; i++) {
+                history[s][i] /= 2;
+            }
+        }
+    }
+}
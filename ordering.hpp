@@ -0,0 +1,49 @@
+#ifndef __ORDERING_H__
+#define __ORDERING_H__
+
+#include <cstdint>
+#include "common.hpp"
+#include "board.hpp"
+
+// Plies of killer moves kept; deeper nodes share the last slot.
+#define ORDER_MAX_PLY 64
+// Below this remaining depth moves are not sorted by opponent mobility.
+#define ORDER_FASTEST_FIRST_DEPTH 3
+
+/*
+ * Orders the moves of a search node, best first:
+ *
+ *   1. the transposition table's move,
+ *   2. the two killer moves of the ply (moves that recently caused a
+ *      cutoff in a sibling),
+ *   3. the rest by history score (how often and how deep the square has
+ *      caused cutoffs) plus a positional prior from HEURISTIC, and, at
+ *      nodes with enough depth left to pay for it, fewest opponent replies
+ *      first.
+ *
+ * One MoveOrder belongs to one search thread. It also counts how often the
+ * first move searched is the one that cuts off.
+ */
+class MoveOrder {
+
+public:
+    MoveOrder();
+
+    void clear();
+    void newSearch();
+    int order(const Board &board, Side side, uint64_t moves, int hashMove,
+              int ply, int depth, int *out);
+    void cutoff(Side side, int sq, int ply, int depth, int moveNumber);
+
+    // Nodes that failed high, and those where the first move did it.
+    uint64_t getCutoffs() const { return cutoffs; }
+    uint64_t getFirstCutoffs() const { return firstCutoffs; }
+
+private:
+    int killers[ORDER_MAX_PLY][2];
+    int history[2][64];
+    uint64_t cutoffs;
+    uint64_t firstCutoffs;
+};
+
+#endif
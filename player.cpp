@@ -1,53 +1,22 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
 #include "player.hpp"
 
 using namespace std;
 
-// Constants
-static const Move init_adj[] = {Move(2,2), Move(3,2), Move(4,2), Move(5,2),
-                                Move(2,3),                       Move(5,3),
-                                Move(2,4),                       Move(5,4),
-                                Move(2,5), Move(3,5), Move(4,5), Move(5,5)};
-
-static const short NUM_ADJACENT_INITIAL = 12;
-static const short NUM_ADJACENT_MOVE = 8;
-
 /*
  * Constructor for the player; initialize everything here. The side your AI is
  * on (BLACK or WHITE) is passed in as "side". The constructor must finish
  * within 30 seconds.
  *
- * small change
+ * tt_megabytes sets the size of the transposition table, which is kept
+ * across doMove calls for the whole game.
  */
-Player::Player(Side side) {
-    // Will be set to true in test_minimax.cpp.
-    testingMinimax = false;
-
+Player::Player(Side side, size_t tt_megabytes)
+    : Player(side, new Board(), tt_megabytes) {
     // Set the AI type
-    this->AI_type = HEURISTIC_AI;
-
-    this->player_side = side;
-    this->op_side = (side == BLACK)? WHITE : BLACK;
-    this->game_board = new Board();
-
-    // Only keep valid moves and add to vector of valid moves
-    for(short i = 0; i < NUM_ADJACENT_INITIAL; i++) {
-      Move m = Move(init_adj[i].x, init_adj[i].y);
-      if(this->game_board->checkMove(&m, this->player_side)) {
-        this->valid_moves.push_back(init_adj[i]);
-      }
-    }
-
-    // Initialize list of occupied spaces
-    for(short x = 0; x < NUM_OTHELLO_SQUARES; x++) {
-      for(short y = 0; y < NUM_OTHELLO_SQUARES; y++) {
-        if(this->game_board->get(WHITE, x, y) ||
-         this->game_board->get(BLACK, x, y)) {
-           this->occupied_spaces.push_back(new Move(x, y));
-         }
-      }
-    }
-
-    return;
+    this->AI_type = ALPHABETA_AI;
 }
 
 /*
@@ -55,36 +24,54 @@ Player::Player(Side side) {
  * on (BLACK or WHITE) is passed in as "side". The constructor must finish
  * within 30 seconds.
  *
- * small change
+ * Starts from the given board instead of the standard setup, and takes
+ * ownership of it. Every other field is set up here; the standard-setup
+ * constructor delegates to this one.
  */
-Player::Player(Side side, Board *b) {
+Player::Player(Side side, Board *b, size_t tt_megabytes)
+    : our_move(-1, -1) {
     // Will be set to true in test_minimax.cpp.
     testingMinimax = false;
 
     // Set the AI type
     this->AI_type = MINIMAX_AI;
+    this->max_depth = SEARCH_MAX_DEPTH;
+    this->endgame_empties = DEFAULT_ENDGAME_EMPTIES;
+    this->use_book = true;
+    this->selective = true;
+    this->canonical_keys = false;
+    this->nodes_searched = 0;
+    this->cutoffs = 0;
+    this->first_cutoffs = 0;
+    this->tt_probes = 0;
+    this->tt_hits = 0;
+    this->prob_cuts = 0;
+    this->log_stats = false;
+    this->moves_played = 0;
+    this->game_log = nullptr;
+    this->learning = false;
+    statsClear(&this->move_stats);
+    this->stop_flag.store(false);
+    this->stop_requested.store(false);
 
     this->player_side = side;
-    this->op_side = (side == BLACK)? WHITE : BLACK;
+    this->op_side = opponent(side);
     this->game_board = b;
+    this->tt = new TranspositionTable(tt_megabytes);
+    this->search.setTable(this->tt);
+    this->search.setStopFlag(&this->stop_flag);
+    this->search.setTimeControl(&this->clock);
+    this->endgame.setStopFlag(&this->stop_flag);
+    this->clock.setStopFlag(&this->stop_flag);
+    this->book.load(BOOK_FILE);
+    this->ponder_search.setTable(this->tt);
+    this->ponder_search.setStopFlag(&this->ponder_flag);
+    this->ponder_flag.store(false);
+    this->pondering = false;
+    this->ponder_move = -1;
+    this->ponder_hits = 0;
 
-    // Only keep valid moves and add to vector of valid moves
-    for(short i = 0; i < NUM_ADJACENT_INITIAL; i++) {
-      Move m = Move(init_adj[i].x, init_adj[i].y);
-      if(this->game_board->checkMove(&m, this->player_side)) {
-        this->valid_moves.push_back(init_adj[i]);
-      }
-    }
-
-    // Initialize list of occupied spaces
-    for(short x = 0; x < NUM_OTHELLO_SQUARES; x++) {
-      for(short y = 0; y < NUM_OTHELLO_SQUARES; y++) {
-        if(this->game_board->get(WHITE, x, y) ||
-         this->game_board->get(BLACK, x, y)) {
-           this->occupied_spaces.push_back(new Move(x, y));
-         }
-      }
-    }
+    this->valid_moves = get_valid_moves(this->game_board, this->player_side);
 
     return;
 }
@@ -93,10 +80,12 @@ Player::Player(Side side, Board *b) {
  * Destructor for the player.
  */
 Player::~Player() {
+    this->stopPondering(nullptr);
+    this->setThreads(1);
     delete game_board;
-
-    for(int i = 0; i < (int)this->occupied_spaces.size(); i++) {
-      delete occupied_spaces[i];
+    delete tt;
+    if(this->game_log != nullptr) {
+      fclose(this->game_log);
     }
 }
 
@@ -111,60 +100,90 @@ Player::~Player() {
  * be disqualified! An msLeft value of -1 indicates no time limit.
  *
  * The move returned must be legal; if there are no valid moves for your side,
- * return nullptr.
+ * return nullptr. It belongs to the player and stays valid until the next
+ * call; callers must not delete it.
  */
 Move *Player::doMove(Move *opponentsMove, int msLeft) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
+    this->stopPondering(opponentsMove);
     this->updateTheirMove(opponentsMove);
+    this->startStats(msLeft);
 
     // Case where no valid moves.
-    if(valid_moves.size() == 0) {
+    if(valid_moves.size == 0) {
+      this->move_stats.source = "pass";
+      this->finishStats(STATS_PASS, start);
       return nullptr;
     }
 
     int ourMoveIndex;
 
+    // The alpha-beta player answers from the book while it can, saving its
+    // clock for the midgame.
+    int book_sq = -1;
+    if(this->use_book && !testingMinimax && this->AI_type == ALPHABETA_AI) {
+      book_sq = this->book.probe(*this->game_board, this->player_side);
+    }
+
     // Figure out what AI to use
-    if(testingMinimax) {
+    if(book_sq >= 0) {
+
+      this->move_stats.source = "book";
+      ourMoveIndex = this->moveIndex(book_sq);
+    }
+    else if(testingMinimax) {
 
+      this->move_stats.source = "minimax";
       ourMoveIndex = this->miniMax(2);
     }
     else {
       switch(this->AI_type) {
         case RANDOM_AI:
         {
+          this->move_stats.source = "random";
           ourMoveIndex = this->randomMove();
           break;
         }
         case HEURISTIC_AI:
         {
+          this->move_stats.source = "heuristic";
           ourMoveIndex = this->heuristicsAI();
           break;
         }
         case MINIMAX_AI:
         {
+          this->move_stats.source = "minimax";
           ourMoveIndex = this->miniMax(2);
           break;
         }
         case FLAT_AI:
         {
+          this->move_stats.source = "flat";
           ourMoveIndex = this->flatEarthHeuristicAI();
           break;
         }
+        case ALPHABETA_AI:
+        {
+          ourMoveIndex = this->alphaBeta(msLeft);
+          break;
+        }
         default:
         {
+          this->move_stats.source = "random";
           ourMoveIndex = this->randomMove();
           break;
         }
       }
     }
 
+    int sq = this->valid_moves[ourMoveIndex];
+    this->finishStats(sq, start);
     this->updateOurMove(ourMoveIndex);
 
-    // Copy the move and return pointer.
-    int move_x = this->valid_moves[ourMoveIndex].getX();
-    int move_y = this->valid_moves[ourMoveIndex].getY();
-    return new Move(move_x, move_y);
+    this->our_move.setX(sq % NUM_OTHELLO_SQUARES);
+    this->our_move.setY(sq / NUM_OTHELLO_SQUARES);
+    return &this->our_move;
 }
 
 /**
@@ -176,7 +195,9 @@ int Player::randomMove() {
      * Picks a ,,random,, move. Some moves are likelier to be made...don't
      * worry about it.
      */
-    int randIndex = rand() % valid_moves.size();
+    // The moves it chooses among are the positions it looks at.
+    this->nodes_searched += valid_moves.size;
+    int randIndex = rand() % valid_moves.size;
     return randIndex;
 }
 
@@ -187,18 +208,16 @@ int Player::randomMove() {
 int Player::heuristicsAI() {
     int hScore = -1000;
     int currentScore;
-    int hIndex;
-    for(int i = 0; i < (int)valid_moves.size(); i++) {
-      Board* newCopy = this->game_board->copy();
-      newCopy->doMove(&valid_moves[i], this->player_side);
-      this->occupied_spaces.push_back(&valid_moves[i]);
-      currentScore = updateHeuristics(newCopy, this->occupied_spaces);
-      this->occupied_spaces.pop_back();
+    int hIndex = 0;
+    for(int i = 0; i < valid_moves.size; i++) {
+      int sq = valid_moves[i];
+      Board newCopy = this->game_board->apply(sq, this->player_side);
+      this->nodes_searched++;
+      currentScore = updateHeuristics(&newCopy);
       if(currentScore > hScore) {
         hIndex = i;
         hScore = currentScore;
       }
-      delete newCopy;
     }
 
     return hIndex;
@@ -211,11 +230,12 @@ int Player::heuristicsAI() {
 int Player::flatEarthHeuristicAI() {
     int hScore = -1000;
     int currentScore;
-    int hIndex;
-    for(int i = 0; i < (int)valid_moves.size(); i++) {
-      int x = valid_moves[i].getX();
-      int y = valid_moves[i].getY();
+    int hIndex = 0;
+    for(int i = 0; i < valid_moves.size; i++) {
+      int x = valid_moves[i] % NUM_OTHELLO_SQUARES;
+      int y = valid_moves[i] / NUM_OTHELLO_SQUARES;
       currentScore = flatHeuristic(x,y);
+      this->nodes_searched++;
       if(currentScore > hScore) {
         hIndex = i;
         hScore = currentScore;
@@ -225,143 +245,558 @@ int Player::flatEarthHeuristicAI() {
     return hIndex;
 }
 
-// Struct for doing the minimax calculations
-typedef struct search_state {
-  int move_index;
-  Move *next_move;
-  Board *board;
-  int depth;
-  bool player_turn;
-} search_state_t;
-
 /**
  * @brief Makes a non-random move determined by using MiniMax.
  *
  */
 int Player::miniMax(int ply) {
 
-    int num_val_moves = this->valid_moves.size();
-    std::vector<int> min_score;
+    // Walk the tree in place on a single board instead of a copy per state.
+    Board board = *this->game_board;
+    int index = 0;
+    int min_max = 0;
+
+    for(int i = 0; i < this->valid_moves.size; i++) {
+      int sq = this->valid_moves[i];
+      uint64_t flipped = board.makeMove(sq, this->player_side);
+      int min_score = this->miniMaxLeaves(&board, 1, ply, false);
+      board.unmakeMove(sq, this->player_side, flipped);
 
-    for(int i = 0; i < num_val_moves; i++) {
-      min_score.push_back(65);
+      // Maximize the minimums
+      if(i == 0 || min_score > min_max) {
+        index = i;
+        min_max = min_score;
+      }
     }
 
-    std::vector<search_state_t> searches;
+    return index;
+}
 
-    // Initialize the stack for searching through the moves
-    for(int i = 0; i < num_val_moves; i++) {
+/**
+ * @brief Finds the lowest leaf score at the given ply below a position.
+ *
+ * @return The minimum score, or 65 if no leaf at that ply is reachable.
+ */
+int Player::miniMaxLeaves(Board *board, int depth, int ply, bool player_turn) {
 
-      search_state_t state;
-      state.move_index = i;
-      state.next_move = &(this->valid_moves[i]);
-      state.board = this->game_board->copy();
-      state.depth = 1;
-      state.player_turn = true;
+    this->nodes_searched++;
 
-      searches.push_back(state);
+    // Case where we have reached the depth we want.
+    if(depth == ply) {
+      return this->superDumbSuperSimpleHeuristic(board);
     }
 
-    // Go through moves
-    while(searches.size() > 0) {
-      search_state_t current_state = searches[searches.size() - 1];
-      searches.pop_back();
+    Side s = (player_turn)? this->player_side : this->op_side;
+    int min_score = 65;
+    uint64_t moves = board->generateMoves(s);
+    while(moves) {
+      int sq = firstSquare(moves);
+      moves &= moves - 1;
 
-      Side s = (current_state.player_turn)? this->player_side : this->op_side;
-      current_state.board->doMove(current_state.next_move, s);
+      uint64_t flipped = board->makeMove(sq, s);
+      int score = this->miniMaxLeaves(board, depth + 1, ply, !player_turn);
+      board->unmakeMove(sq, s, flipped);
 
-      // Case where we have reached the depth we want.
-      if(current_state.depth == ply) {
-        int score = this->superDumbSuperSimpleHeuristic(current_state.board);
-        if(score < min_score[current_state.move_index]) {
-          min_score[current_state.move_index] = score;
+      if(score < min_score) {
+        min_score = score;
+      }
+    }
+
+    return min_score;
+}
+
+/**
+ * @brief Makes a move chosen by iterative-deepening alpha-beta search, or
+ * by the exact endgame solver once few enough squares are empty.
+ *
+ * @return Index into valid_moves of the chosen move.
+ */
+int Player::alphaBeta(int msLeft) {
+    // A forced move needs no thought.
+    if(this->valid_moves.size == 1) {
+      this->move_stats.source = "forced";
+      return 0;
+    }
+
+    int empties = 64 - this->game_board->countBlack() -
+                  this->game_board->countWhite();
+
+    if(this->learning) {
+      this->learned.touch(*this->game_board, this->player_side);
+      // Entries stored at load time may have been replaced by now; store
+      // the ones just ahead again where the tables have lost them.
+      this->primeLearned(empties - LEARN_PRIME_EMPTIES, empties);
+    }
+
+    if(empties <= this->endgame_empties) {
+      this->endgame.setCanonical(this->canonical_keys);
+      this->clock.startExact(msLeft, empties);
+      this->honorStopRequest();
+      int sq = this->endgame.solve(*this->game_board, this->player_side,
+                                   this->clock.getMaximum());
+      this->clock.finishExact(this->endgame.wasStopped());
+      this->nodes_searched += this->endgame.getNodes();
+      this->tt_probes += this->endgame.getCacheProbes();
+      this->tt_hits += this->endgame.getCacheHits();
+      if(!this->endgame.wasStopped()) {
+        if(this->learning) {
+          this->learned.record(*this->game_board, this->player_side, empties,
+                               this->endgame.getScore(), sq, true);
         }
+#if SEARCH_STATS
+        this->move_stats.source = "endgame";
+        this->move_stats.depth = empties;
+        this->move_stats.score = this->endgame.getScore();
+        this->move_stats.pvLength =
+          this->endgame.getPV(*this->game_board, this->player_side, sq,
+                              this->move_stats.pv, STATS_MAX_PV);
+#endif
+        return this->moveIndex(sq);
       }
-      // Continue calculating
-      else {
-        Side next_side = (!current_state.player_turn)?
-          this->player_side:this->op_side;
-        std::vector<Move> next_moves =
-          get_valid_moves(current_state.board, next_side);
-
-        for(int i = 0; i < (int)next_moves.size(); i++) {
-          // Create all of the next states to look at and push them in.
-          search_state_t next_state;
-          next_state.move_index = current_state.move_index;
-          next_state.next_move = &next_moves[i];
-          next_state.board = current_state.board->copy();
-          next_state.depth = current_state.depth + 1;
-          next_state.player_turn = !current_state.player_turn;
-
-          searches.push_back(next_state);
+
+      // Too slow to solve yet; fall back to the heuristic search with the
+      // time that is left.
+      if(msLeft >= 0) {
+        msLeft -= this->clock.elapsed();
+        if(msLeft < 0) {
+          msLeft = 0;
         }
       }
+    }
 
-      delete current_state.board;
+    this->tt->newSearch();
+    this->clock.start(msLeft, empties);
+    this->honorStopRequest();
+    this->search.setSelective(this->selective);
+    this->search.setCanonical(this->canonical_keys);
+    for(int i = 0; i < (int)this->helpers.size(); i++) {
+      this->helpers[i]->setSelective(this->selective);
+      this->helpers[i]->setCanonical(this->canonical_keys);
+    }
+    int sq;
+    if(!this->helpers.empty()) {
+      sq = this->parallelSearch(this->clock.getMaximum());
+    }
+    else {
+      sq = this->search.run(*this->game_board, this->player_side,
+                            this->max_depth, this->clock.getMaximum());
+      this->nodes_searched += this->search.getNodes();
+      this->cutoffs += this->search.getCutoffs();
+      this->first_cutoffs += this->search.getFirstCutoffs();
+      this->tt_probes += this->search.getTableProbes();
+      this->tt_hits += this->search.getTableHits();
+      this->prob_cuts += this->search.getProbCuts();
+    }
+    this->clock.finish();
+
+    // The search whose move was chosen: as in parallelSearch, the main one
+    // unless a helper completed a deeper iteration.
+    Search *chosen = &this->search;
+    for(int i = 0; i < (int)this->helpers.size(); i++) {
+      if(this->helpers[i]->getDepth() > chosen->getDepth()) {
+        chosen = this->helpers[i];
+      }
+    }
+    if(this->learning) {
+      this->learned.record(*this->game_board, this->player_side,
+                           chosen->getDepth(), chosen->getScore(), sq, false);
     }
 
-    // Maximize the minimums
-    int index = 0;
-    int min_max = min_score[0];
-    for(int i = 1; i < num_val_moves; i++) {
-      if(min_score[i] > min_max) {
-        index = i;
-        min_max = min_score[i];
+#if SEARCH_STATS
+    this->move_stats.source = "search";
+    this->move_stats.depth = chosen->getDepth();
+    this->move_stats.score = chosen->getScore();
+    this->move_stats.pvLength =
+      chosen->getPV(*this->game_board, this->player_side, sq,
+                    this->move_stats.pv, STATS_MAX_PV);
+#endif
+    return this->moveIndex(sq);
+}
+
+/**
+ * @brief Runs the main search with every helper search on its own thread.
+ *
+ * The helpers only feed the shared transposition table, except that a
+ * helper which completed a deeper iteration than the main search supplies
+ * the move.
+ *
+ * @return The chosen square.
+ */
+int Player::parallelSearch(int msBudget) {
+    // The clock has lowered stop_flag for this move.
+    std::vector<std::thread> threads;
+    for(int i = 0; i < (int)this->helpers.size(); i++) {
+      threads.push_back(std::thread(&Search::run, this->helpers[i],
+                                    std::cref(*this->game_board),
+                                    this->player_side, this->max_depth,
+                                    msBudget));
+    }
+
+    int sq = this->search.run(*this->game_board, this->player_side,
+                              this->max_depth, msBudget);
+    int depth = this->search.getDepth();
+
+    this->stop_flag.store(true);
+    for(int i = 0; i < (int)threads.size(); i++) {
+      threads[i].join();
+    }
+
+    this->nodes_searched += this->search.getNodes();
+    this->cutoffs += this->search.getCutoffs();
+    this->first_cutoffs += this->search.getFirstCutoffs();
+    this->tt_probes += this->search.getTableProbes();
+    this->tt_hits += this->search.getTableHits();
+    this->prob_cuts += this->search.getProbCuts();
+    for(int i = 0; i < (int)this->helpers.size(); i++) {
+      this->nodes_searched += this->helpers[i]->getNodes();
+      this->cutoffs += this->helpers[i]->getCutoffs();
+      this->first_cutoffs += this->helpers[i]->getFirstCutoffs();
+      this->tt_probes += this->helpers[i]->getTableProbes();
+      this->tt_hits += this->helpers[i]->getTableHits();
+      this->prob_cuts += this->helpers[i]->getProbCuts();
+    }
+
+    for(int i = 0; i < (int)this->helpers.size(); i++) {
+      if(this->helpers[i]->getDepth() > depth) {
+        sq = this->helpers[i]->getMove();
+        depth = this->helpers[i]->getDepth();
       }
     }
+    return sq;
+}
 
-    return index;
+/**
+ * @brief Sets how many threads the alpha-beta search uses. With one thread
+ * the search runs exactly as it does without helpers.
+ */
+void Player::setThreads(int threads) {
+    while((int)this->helpers.size() > threads - 1 && !this->helpers.empty()) {
+      delete this->helpers.back();
+      this->helpers.pop_back();
+    }
+    while((int)this->helpers.size() < threads - 1) {
+      Search *helper = new Search();
+      helper->setTable(this->tt);
+      helper->setStopFlag(&this->stop_flag);
+      helper->setHelper(this->helpers.size() + 1);
+      this->helpers.push_back(helper);
+    }
 }
 
 /**
- * @brief Gets valid moves from a board.
+ * @brief Asks a doMove running on another thread to return as soon as it
+ * can. The search still completes its first iteration, so the move is
+ * legal. The request holds until clearStopRequest.
+ */
+void Player::requestStop() {
+    this->stop_requested.store(true);
+    this->stop_flag.store(true);
+}
+
+/**
+ * @brief Withdraws requestStop, before the next doMove.
  */
-std::vector<Move> Player::get_valid_moves(Board *b, Side s) {
-    std::vector<Move> valid;
-
-    for(short x = 0; x < NUM_OTHELLO_SQUARES; x++) {
-      for(short y = 0; y < NUM_OTHELLO_SQUARES; y++) {
-        Move *m = new Move(x, y);
-        if(b->checkMove(m, s)) {
-           valid.push_back(Move(x, y));
+void Player::clearStopRequest() {
+    this->stop_requested.store(false);
+}
+
+/**
+ * @brief Raises stop_flag again if a stop was requested; starting the clock
+ * lowers it.
+ */
+void Player::honorStopRequest() {
+    if(this->stop_requested.load()) {
+      this->stop_flag.store(true);
+    }
+}
+
+/**
+ * @brief Keeps searching on a background thread after our move has been
+ * sent, from the opponent's point of view, until their move arrives.
+ *
+ * The search fills the shared transposition table (or the solver's cache
+ * once our next move will be solved exactly) with every reply, the expected
+ * one first, so the next search starts from deep results instead of an
+ * empty table.
+ */
+void Player::startPondering() {
+    if(this->pondering || this->testingMinimax ||
+       this->AI_type != ALPHABETA_AI) {
+      return;
+    }
+
+    this->ponder_flag.store(false);
+    this->ponder_move = -1;
+    this->endgame.setStopFlag(&this->ponder_flag);
+    this->pondering = true;
+    this->ponder_thread = std::thread(&Player::ponder, this);
+}
+
+/**
+ * @brief Stops pondering, if it is running, and notes whether the
+ * opponent played the reply it expected.
+ */
+void Player::stopPondering(Move *opponentsMove) {
+    if(!this->pondering) {
+      return;
+    }
+
+    this->ponder_flag.store(true);
+    this->ponder_thread.join();
+    this->endgame.setStopFlag(&this->stop_flag);
+    this->pondering = false;
+
+    if(opponentsMove != nullptr && this->ponder_move ==
+       opponentsMove->getX() + NUM_OTHELLO_SQUARES * opponentsMove->getY()) {
+      this->ponder_hits++;
+    }
+}
+
+/**
+ * @brief Body of the pondering thread.
+ */
+void Player::ponder() {
+    int empties = 64 - this->game_board->countBlack() -
+                  this->game_board->countWhite();
+
+    if(empties - 1 <= this->endgame_empties) {
+      this->endgame.setCanonical(this->canonical_keys);
+      int sq = this->endgame.solve(*this->game_board, this->op_side, -1);
+      if(!this->endgame.wasStopped()) {
+        this->ponder_move = sq;
+      }
+      return;
+    }
+
+    this->ponder_search.setSelective(this->selective);
+    this->ponder_search.setCanonical(this->canonical_keys);
+    this->ponder_search.run(*this->game_board, this->op_side,
+                            this->max_depth, -1);
+    this->ponder_move = this->ponder_search.getMove();
+}
+
+/**
+ * @brief Writes the statistics of every move from now on to a file, one
+ * JSON object per line (see statsWriteJson).
+ *
+ * @return False if the file can't be opened, or statistics are compiled
+ * out.
+ */
+bool Player::openGameLog(const char *path) {
+#if SEARCH_STATS
+    FILE *file = fopen(path, "w");
+    if(file == nullptr) {
+      return false;
+    }
+    if(this->game_log != nullptr) {
+      fclose(this->game_log);
+    }
+    this->game_log = file;
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+/**
+ * @brief Turns on learning across games: loads the results kept in the
+ * file at path into the tables, and keeps this game's for saveLearned.
+ * Call it before the first move, once canonical_keys is set.
+ *
+ * @return False if there was no usable file, so learning starts afresh.
+ */
+bool Player::loadLearned(const char *path) {
+    this->learning = true;
+    bool loaded = this->learned.load(path);
+
+    this->primed.clear();
+    for(size_t i = 0; i < this->learned.getSize(); i++) {
+      this->primed.push_back(this->learned.getEntry(i));
+    }
+    std::stable_sort(this->primed.begin(), this->primed.end(),
+                     [](const LearnedEntry &a, const LearnedEntry &b) {
+                       return popCount(a.black | a.white) >
+                              popCount(b.black | b.white);
+                     });
+    this->primeLearned(0, 64);
+    return loaded;
+}
+
+/**
+ * @brief Saves this game's results, merged with those already kept in the
+ * file at path.
+ */
+bool Player::saveLearned(const char *path) {
+    if(!this->learning) {
+      return false;
+    }
+    return this->learned.save(path);
+}
+
+/**
+ * @brief Stores the loaded results for positions with minEmpties to
+ * maxEmpties empty squares in the tables: search results in the
+ * transposition table, exact ones there and in the endgame cache. A
+ * position the tables already know at least as deeply is left alone, so a
+ * result from an earlier game never replaces one from this game's search.
+ */
+void Player::primeLearned(int minEmpties, int maxEmpties) {
+    this->endgame.setCanonical(this->canonical_keys);
+    // Without canonical keys every orientation has its own key.
+    int orientations = this->canonical_keys ? 1 : 8;
+
+    // primed runs from the fewest empties to the most.
+    std::vector<LearnedEntry>::const_iterator it = std::lower_bound(
+      this->primed.begin(), this->primed.end(), minEmpties,
+      [](const LearnedEntry &entry, int empties) {
+        return 64 - popCount(entry.black | entry.white) < empties;
+      });
+    for(; it != this->primed.end(); ++it) {
+      const LearnedEntry &entry = *it;
+      int empties = 64 - popCount(entry.black | entry.white);
+      if(empties > maxEmpties) {
+        break;
+      }
+
+      Side side = (Side)entry.toMove;
+      int depth = entry.depth;
+      int score = entry.score;
+      if(entry.exact) {
+        // Settles the position for a search of any depth, scored like a
+        // finished game.
+        depth = SEARCH_MAX_DEPTH;
+        score = (entry.score > 0) ? SCORE_WIN + entry.score
+              : (entry.score < 0) ? -SCORE_WIN + entry.score : 0;
+      }
+
+      Board canonical;
+      canonical.setPieces(entry.black, entry.white);
+      for(int sym = 0; sym < orientations; sym++) {
+        Board board = canonical.transform(sym);
+        int move = transformSquare(entry.move, sym);
+        int keySymmetry = 0;
+        uint64_t key = this->canonical_keys
+          ? board.getCanonicalHash(side, &keySymmetry)
+          : board.getHash(side);
+        TTData known;
+        if(!this->tt->probe(key, &known) || known.depth < depth) {
+          this->tt->store(key, depth, BOUND_EXACT, score,
+                          transformSquare(move, keySymmetry));
+        }
+        if(entry.exact) {
+          this->endgame.learn(board, side, entry.score, move);
         }
-        delete m;
       }
     }
+}
+
+/**
+ * @brief Starts the statistics of a doMove call. Until finishStats, the
+ * counters in move_stats hold the game totals so far.
+ */
+void Player::startStats(int msLeft) {
+#if SEARCH_STATS
+    statsClear(&this->move_stats);
+    this->move_stats.side = this->player_side;
+    this->move_stats.msLeft = msLeft;
+    this->move_stats.empties = 64 - this->game_board->countBlack() -
+                               this->game_board->countWhite();
+    this->move_stats.nodes = this->nodes_searched;
+    this->move_stats.ttProbes = this->tt_probes;
+    this->move_stats.ttHits = this->tt_hits;
+    this->move_stats.cutoffs = this->cutoffs;
+    this->move_stats.firstCutoffs = this->first_cutoffs;
+    this->move_stats.probCuts = this->prob_cuts;
+#else
+    (void)msLeft;
+#endif
+}
+
+/**
+ * @brief Completes the statistics of a doMove call that plays sq, and
+ * reports them where asked to.
+ */
+void Player::finishStats(int sq, chrono::steady_clock::time_point start) {
+    this->moves_played++;
+#if SEARCH_STATS
+    MoveStats &stats = this->move_stats;
+    stats.number = this->moves_played;
+    stats.move = sq;
+    stats.ms = chrono::duration<double, std::milli>(
+      chrono::steady_clock::now() - start).count();
+    stats.nodes = this->nodes_searched - stats.nodes;
+    stats.ttProbes = this->tt_probes - stats.ttProbes;
+    stats.ttHits = this->tt_hits - stats.ttHits;
+    stats.cutoffs = this->cutoffs - stats.cutoffs;
+    stats.firstCutoffs = this->first_cutoffs - stats.firstCutoffs;
+    stats.probCuts = this->prob_cuts - stats.probCuts;
+    if(stats.pvLength == 0 && sq != STATS_PASS) {
+      stats.pv[0] = sq;
+      stats.pvLength = 1;
+    }
 
-    return valid;
+    if(this->log_stats) {
+      statsPrint(stderr, stats);
+    }
+    if(this->game_log != nullptr) {
+      statsWriteJson(this->game_log, stats);
+      fflush(this->game_log);
+    }
+#else
+    (void)sq;
+    (void)start;
+#endif
 }
 
 /**
- * @brief Updates the list of valid adjacent moves after our move.
+ * @brief Finds a square (x + 8*y) in valid_moves.
  *
+ * @return Its index, or 0 if it isn't there.
  */
-void Player::updateOurMove(int index) {
+int Player::moveIndex(int sq) {
+    for(int i = 0; i < this->valid_moves.size; i++) {
+      if(this->valid_moves[i] == sq) {
+        return i;
+      }
+    }
+    return 0;
+}
 
-    int x = valid_moves[index].getX();
-    int y = valid_moves[index].getY();
+/**
+ * @brief Gets valid moves from a board.
+ */
+MoveList Player::get_valid_moves(Board *b, Side s) {
+    MoveList valid;
+
+    uint64_t moves = b->generateMoves(s);
+    while(moves) {
+      valid.push(firstSquare(moves));
+      moves &= moves - 1;
+    }
 
-    // Update Move List and board
-    Move *m = new Move(x, y);
-    this->game_board->doMove(m, this->player_side);
-    this->updateMoves(m);
+    return valid;
 }
 
 /**
- * @brief Updates the list of valid adjacent moves after their move.
+ * @brief Plays our move on the board.
+ *
+ */
+void Player::updateOurMove(int index) {
+    this->game_board->makeMove(valid_moves[index], this->player_side);
+}
+
+/**
+ * @brief Plays their move on the board and finds our valid moves.
  *
  */
 void Player::updateTheirMove(Move *m) {
 
-    // Update moves
+    // Update board
     if(m != nullptr) {
 
-      int x = m->getX();
-      int y = m->getY();
-
-      Move *move = new Move(x, y);
-      this->game_board->doMove(move, this->op_side);
-      this->updateMoves(move);
+      int sq = m->getX() + NUM_OTHELLO_SQUARES * m->getY();
+      this->game_board->makeMove(sq, this->op_side);
     }
 
     // Update Move List
@@ -369,12 +804,21 @@ void Player::updateTheirMove(Move *m) {
 }
 
 /**
- * @brief Updates the moves list.
+ * @brief Tells whether the opponent may play a square on the current board:
+ * it must be empty and flip at least one of our discs. A negative square is
+ * a pass, which is only legal when they have no move.
  *
+ * @return True if the move is legal.
  */
-void Player::updateMoves(Move *m) {
-    this->occupied_spaces.push_back(new Move(m->getX(), m->getY()));
-    return;
+bool Player::checkTheirMove(int sq) {
+    uint64_t moves = this->game_board->generateMoves(this->op_side);
+    if(sq < 0) {
+      return moves == 0;
+    }
+    if(sq >= 64) {
+      return false;
+    }
+    return (moves >> sq) & 1;
 }
 
 /**
@@ -382,14 +826,15 @@ void Player::updateMoves(Move *m) {
  *
  * @return The hueristic function's value given a board state.
  */
-int Player::updateHeuristics(Board *board, vector<Move *> token_spaces) {
+int Player::updateHeuristics(Board *board) {
     int our_score = 0;
     int their_score = 0;
 
-    for(int i = 0; i < (int)token_spaces.size(); i++) {
+    for(uint64_t taken = board->getTaken(); taken; taken &= taken - 1) {
 
-      int x = token_spaces[i]->getX();
-      int y = token_spaces[i]->getY();
+      int sq = firstSquare(taken);
+      int x = sq % NUM_OTHELLO_SQUARES;
+      int y = sq / NUM_OTHELLO_SQUARES;
 
       if(board->get(this->player_side, x, y)) {
         our_score += HEURISTIC[x][y];
@@ -400,8 +845,8 @@ int Player::updateHeuristics(Board *board, vector<Move *> token_spaces) {
     }
     int aggregate = our_score - their_score;
 
-    int our_mobility = get_valid_moves(board, this->player_side).size();
-    int their_mobility = get_valid_moves(board, this->op_side).size();
+    int our_mobility = popCount(board->generateMoves(this->player_side));
+    int their_mobility = popCount(board->generateMoves(this->op_side));
     int mobility_score = our_mobility - their_mobility;
 
     return 4 * mobility_score + aggregate;
@@ -417,8 +862,5 @@ int Player::flatHeuristic(int x, int y) {
  * @return The hueristic function's value given a board state.
  */
 int Player::superDumbSuperSimpleHeuristic(Board *board) {
-    if(this->player_side == BLACK){
-      return board->countBlack() - board->countWhite();
-    }
-    return board->countWhite() - board->countBlack();
+    return board->count(this->player_side) - board->count(this->op_side);
 }
@@ -1,24 +1,20 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
+#include <thread>
 #include <vector>
 #include "common.hpp"
 #include "board.hpp"
-
-#define NUM_OTHELLO_SQUARES 8
+#include "search.hpp"
+#include "endgame.hpp"
+#include "book.hpp"
+#include "timectl.hpp"
+#include "stats.hpp"
+#include "learn.hpp"
 
 using namespace std;
 
-static const short HEURISTIC[NUM_OTHELLO_SQUARES][NUM_OTHELLO_SQUARES] =
-{
-  {  255,  -64,   32,   16,   16,   32,  -64,  255},
-  {  -64, -128,   32,    4,    4,   32, -128,  -64},
-  {   32,   32,   32,    4,    4,   32,   32,   32},
-  {   16,    4,    4,    4,    4,    4,    4,   16},
-  {   16,    4,    4,    4,    4,    4,    4,   16},
-  {   32,   32,   32,    4,    4,   32,   32,   32},
-  {  -64, -128,   32,    4,    4,   32, -128,  -64},
-  {  255,  -64,   32,   16,   16,   32,  -64,  255}
-};
-
 /**
  * @brief Tells what type of AI to use.
  */
@@ -26,37 +22,66 @@ typedef enum AI {
   RANDOM_AI,
   HEURISTIC_AI,
   MINIMAX_AI,
-  FLAT_AI
+  FLAT_AI,
+  ALPHABETA_AI
 } AI_t;
 
 class Player {
 
 public:
-    Player(Side side);
-    Player(Side s, Board *b);
+    Player(Side side, size_t tt_megabytes = DEFAULT_TT_MB);
+    Player(Side s, Board *b, size_t tt_megabytes = DEFAULT_TT_MB);
     ~Player();
 
     Move *doMove(Move *opponentsMove, int msLeft);
 
-    int updateHeuristics(Board *board, vector<Move *> token_spaces);
+    int updateHeuristics(Board *board);
     int superDumbSuperSimpleHeuristic(Board *board);
-    std::vector<Move> get_valid_moves(Board *b, Side s);
-    void updateMoves(Move *m);
+    MoveList get_valid_moves(Board *b, Side s);
     void updateOurMove(int index);
     void updateTheirMove(Move *m);
-    void clearNeighborsFromMoves(int x, int y);
+    bool checkTheirMove(int sq);
     int flatHeuristic(int x, int y);
 
     int randomMove();
     int heuristicsAI();
     int flatEarthHeuristicAI();
     int miniMax(int depth);
+    int miniMaxLeaves(Board *board, int depth, int ply, bool player_turn);
+    int alphaBeta(int msLeft);
+    int moveIndex(int sq);
+    int parallelSearch(int msBudget);
+    void setThreads(int threads);
+    void requestStop();
+    void clearStopRequest();
+    void startPondering();
+    void stopPondering(Move *opponentsMove);
+    uint64_t getPonderHits() { return ponder_hits; }
+    uint64_t getNodes() { return nodes_searched; }
+    uint64_t getCutoffs() { return cutoffs; }
+    uint64_t getFirstCutoffs() { return first_cutoffs; }
+    const MoveStats &getMoveStats() { return move_stats; }
+    bool openGameLog(const char *path);
+    bool loadLearned(const char *path);
+    bool saveLearned(const char *path);
 
 
     // Flag to tell if the player is running within the test_minimax context
     bool testingMinimax;
     // Type of AI to use normally
     AI_t AI_type;
+    // Deepest iteration the alpha-beta search may run
+    int max_depth;
+    // Solve exactly once there are this many empty squares or fewer
+    int endgame_empties;
+    // Play from the opening book while the position is in it
+    bool use_book;
+    // Let the alpha-beta search prune with Multi-ProbCut
+    bool selective;
+    // Share table entries between the 8 orientations of a position
+    bool canonical_keys;
+    // Print a stats line on stderr after every move (needs SEARCH_STATS)
+    bool log_stats;
 
 private:
     // The Game Board
@@ -66,7 +91,65 @@ private:
     // The Opponent's side
     Side op_side;
     // Valid moves
-    std::vector<Move> valid_moves;
-    // Occupied spaces
-    std::vector<Move *> occupied_spaces;
+    MoveList valid_moves;
+    // The move doMove last returned
+    Move our_move;
+    // Transposition table, kept for the whole game
+    TranspositionTable *tt;
+    // Alpha-beta search engine
+    Search search;
+    // Exact endgame solver
+    Endgame endgame;
+    // Opening book, mapped from BOOK_FILE if it exists
+    OpeningBook book;
+    // Extra searches run on their own threads, sharing tt (Lazy SMP)
+    std::vector<Search *> helpers;
+    // Raised to stop the helpers once the main search is done, or by the
+    // clock's watchdog to stop every engine
+    std::atomic<bool> stop_flag;
+    // Set by requestStop until clearStopRequest; raises stop_flag again
+    // whenever the clock rearms it
+    std::atomic<bool> stop_requested;
+    // Per-move time limits
+    TimeControl clock;
+    // Nodes searched by every engine over the whole game
+    uint64_t nodes_searched;
+    // Fail-high nodes of the alpha-beta searches, and those where the first
+    // move searched cut off
+    uint64_t cutoffs;
+    uint64_t first_cutoffs;
+    // Table lookups, table hits and ProbCut prunes over the whole game
+    uint64_t tt_probes;
+    uint64_t tt_hits;
+    uint64_t prob_cuts;
+
+    void ponder();
+    void honorStopRequest();
+    void primeLearned(int minEmpties, int maxEmpties);
+    void startStats(int msLeft);
+    void finishStats(int sq, std::chrono::steady_clock::time_point start);
+
+    // Statistics of the last doMove call
+    MoveStats move_stats;
+    // Our moves so far this game
+    int moves_played;
+    // JSON log of every move's statistics; may be null
+    FILE *game_log;
+
+    // Results kept across games, once loadLearned has been called
+    LearnedCache learned;
+    bool learning;
+    // The results loaded, ordered by empty squares, for primeLearned
+    std::vector<LearnedEntry> primed;
+
+    // Searches the opponent's position while they think
+    Search ponder_search;
+    std::thread ponder_thread;
+    // Raised to end pondering when their move arrives
+    std::atomic<bool> ponder_flag;
+    bool pondering;
+    // Reply the ponder search expected, or -1
+    int ponder_move;
+    // Opponent moves that matched ponder_move
+    uint64_t ponder_hits;
 };
@@ -0,0 +1,421 @@
+#include <cmath>
+#include "search.hpp"
+
+using namespace std;
+
+// Nodes searched between two looks at the clock.
+static const uint64_t NODES_PER_TIME_CHECK = 1024;
+// ProbCut prunes when the shallow search is this many standard deviations
+// of the prediction error past the bound.
+static const double MPC_THRESHOLD = 1.5;
+
+Search::Search() {
+    table = nullptr;
+    stopFlag = nullptr;
+    helperId = 0;
+    clock = nullptr;
+    selective = true;
+    canonical = false;
+    probCuts = 0;
+    tableProbes = 0;
+    tableHits = 0;
+    interruptible = false;
+    limited = false;
+    stopped = false;
+    nodes = 0;
+    bestMove = -1;
+    bestScore = 0;
+    depthReached = 0;
+    feat = featureStack;
+    evalInit();
+}
+
+Search::~Search() {
+}
+
+/*
+ * Runs an iterative-deepening negamax alpha-beta search from the given
+ * position with `side` to move, and returns the best square (x + 8*y) of the
+ * last iteration that completed, or -1 if the side has to pass.
+ *
+ * Iterations stop at maxDepth, once msBudget milliseconds have passed (a
+ * negative budget means no time limit), or when the stop flag is raised.
+ * With a time control the main search ignores msBudget: the clock's
+ * maximum cuts an iteration short, and the clock decides after each one
+ * whether to start another. The main search always completes its first
+ * iteration, so a move is returned even with a budget of 0.
+ *
+ * Helper searches of a parallel search run the same loop against the shared
+ * table until they are stopped. Odd helpers search one ply deeper per
+ * iteration and every helper rotates its root moves, so threads spread over
+ * different parts of the tree.
+ */
+int Search::run(const Board &board, Side side, int maxDepth, int msBudget) {
+    Board root = board;
+    int rootMoves[NUM_OTHELLO_SQUARES * NUM_OTHELLO_SQUARES];
+    int numMoves = 0;
+
+    uint64_t moves = root.generateMoves(side);
+    while (moves) {
+        rootMoves[numMoves++] = firstSquare(moves);
+        moves &= moves - 1;
+    }
+
+    feat = featureStack;
+    evalFeatures(root, feat);
+
+    nodes = 0;
+    probCuts = 0;
+    tableProbes = 0;
+    tableHits = 0;
+    ordering.newSearch();
+    stopped = false;
+    interruptible = false;
+    limited = false;
+    bestMove = (numMoves > 0) ? rootMoves[0] : -1;
+    bestScore = 0;
+    depthReached = 0;
+    if (numMoves == 0) return -1;
+
+    if (helperId > 0) {
+        int shift = helperId % numMoves;
+        int rotated[NUM_OTHELLO_SQUARES * NUM_OTHELLO_SQUARES];
+        for (int i = 0; i < numMoves; i++) {
+            rotated[i] = rootMoves[(i + shift) % numMoves];
+        }
+        for (int i = 0; i < numMoves; i++) {
+            rootMoves[i] = rotated[i];
+        }
+    }
+
+    // Try the move stored for this position (usually from the search on our
+    // previous turn) first.
+    TTData hit;
+    if (table != nullptr && helperId == 0) {
+        int symmetry;
+        if (table->probe(tableKey(root, side, &symmetry), &hit) &&
+            hit.move != TT_NO_MOVE) {
+            int move = transformSquare(hit.move, SYMMETRY_INVERSE[symmetry]);
+            for (int i = 1; i < numMoves; i++) {
+                if (rootMoves[i] == move) {
+                    rootMoves[i] = rootMoves[0];
+                    rootMoves[0] = move;
+                    break;
+                }
+            }
+        }
+    }
+
+    int empties = 64 - popCount(root.getTaken());
+    if (maxDepth > empties) maxDepth = empties;
+    if (maxDepth < 1) maxDepth = 1;
+
+    // An iteration that starts after half the budget is gone would rarely
+    // finish, so don't start one.
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chrono::steady_clock::time_point lastStart =
+        start + chrono::milliseconds(msBudget / 2);
+
+    int firstDepth = (helperId > 0) ? 1 + helperId % 2 : 1;
+    int step = (helperId > 0) ? 1 + helperId % 2 : 1;
+    bool timed = (clock != nullptr && helperId == 0);
+    for (int depth = firstDepth; depth <= maxDepth; depth += step) {
+        // Only later iterations of the main search may be cut short.
+        if (depth > 1 || helperId > 0) {
+            interruptible = true;
+            limited = timed || (msBudget >= 0);
+            deadline = timed ? clock->getDeadline()
+                             : start + chrono::milliseconds(msBudget);
+        }
+
+        int score = (side == BLACK)
+            ? searchRoot<BLACK>(root, depth, rootMoves, numMoves)
+            : searchRoot<WHITE>(root, depth, rootMoves, numMoves);
+        if (stopped) break;
+
+        bestMove = rootMoves[0];
+        bestScore = score;
+        depthReached = depth;
+
+        // Nothing left to learn once the result is a proven win or loss.
+        if (score >= SCORE_WIN || score <= -SCORE_WIN) break;
+        if (timed) {
+            if (!clock->nextIteration(bestMove, bestScore)) break;
+        } else if (helperId == 0 && limited &&
+                   chrono::steady_clock::now() >= lastStart) {
+            break;
+        }
+        if (stopFlag != nullptr && stopFlag->load(memory_order_relaxed)) break;
+    }
+
+    return bestMove;
+}
+
+/*
+ * Searches every root move to the given depth. The best move is moved to the
+ * front of rootMoves so the next iteration tries it first.
+ */
+template <Side side>
+int Search::searchRoot(Board &board, int depth, int *rootMoves,
+                       int numMoves) {
+    int alpha = -SCORE_INF;
+    int bestIndex = 0;
+
+    for (int i = 0; i < numMoves; i++) {
+        uint64_t flipped;
+        makeMove<side>(board, rootMoves[i], &flipped);
+        int score = -negamax<opponent(side)>(board, depth - 1, -SCORE_INF,
+                                             -alpha, false);
+        unmakeMove<side>(board, rootMoves[i], flipped);
+        if (stopped) return 0;
+
+        if (score > alpha) {
+            alpha = score;
+            bestIndex = i;
+        }
+    }
+
+    int best = rootMoves[bestIndex];
+    for (int i = bestIndex; i > 0; i--) {
+        rootMoves[i] = rootMoves[i - 1];
+    }
+    rootMoves[0] = best;
+
+    if (table != nullptr) {
+        int symmetry;
+        uint64_t key = tableKey(board, side, &symmetry);
+        table->store(key, depth, BOUND_EXACT, alpha,
+                     transformSquare(best, symmetry));
+    }
+    return alpha;
+}
+
+/*
+ * Writes the line the table expects after `side` plays `first`: each
+ * following position's stored move, with STATS_PASS for a pass. Returns
+ * its length, at most maxLength.
+ */
+int Search::getPV(const Board &board, Side side, int first, int *pv,
+                  int maxLength) {
+    Board position = board;
+    int sq = first;
+    int length = 0;
+    while (sq >= 0 && length < maxLength) {
+        pv[length++] = sq;
+        position.makeMove(sq, side);
+        side = opponent(side);
+        if (table == nullptr) break;
+
+        uint64_t moves = position.generateMoves(side);
+        bool pass = (moves == 0);
+        if (pass) {
+            side = opponent(side);
+            moves = position.generateMoves(side);
+            if (moves == 0) break;
+        }
+
+        int symmetry;
+        TTData hit;
+        if (!table->probe(tableKey(position, side, &symmetry), &hit) ||
+            hit.move == TT_NO_MOVE) {
+            break;
+        }
+        sq = transformSquare(hit.move, SYMMETRY_INVERSE[symmetry]);
+        if (((moves >> sq) & 1) == 0) break;
+        if (pass) {
+            if (length == maxLength) break;
+            pv[length++] = STATS_PASS;
+        }
+    }
+    return length;
+}
+
+/*
+ * Negamax alpha-beta: returns the score of the position for `side`. passed
+ * is true when the previous move was a pass, so two in a row end the game.
+ */
+template <Side side>
+int Search::negamax(Board &board, int depth, int alpha, int beta,
+                    bool passed) {
+    nodes++;
+    if (nodes % NODES_PER_TIME_CHECK == 0 && shouldStop()) {
+        stopped = true;
+    }
+    if (stopped) return 0;
+
+    // A stored result at least as deep as this one may settle the node; a
+    // shallower one still supplies the move to try first.
+    int symmetry = 0;
+    uint64_t key = tableKey(board, side, &symmetry);
+    int hashMove = TT_NO_MOVE;
+    TTData hit;
+    if (table != nullptr) STATS_COUNT(tableProbes);
+    if (table != nullptr && table->probe(key, &hit)) {
+        STATS_COUNT(tableHits);
+        if (hit.move != TT_NO_MOVE) {
+            hashMove = transformSquare(hit.move, SYMMETRY_INVERSE[symmetry]);
+        }
+        if (hit.depth >= depth) {
+            if (hit.bound == BOUND_EXACT) return hit.score;
+            if (hit.bound == BOUND_LOWER && hit.score >= beta) return hit.score;
+            if (hit.bound == BOUND_UPPER && hit.score <= alpha) return hit.score;
+        }
+    }
+
+    uint64_t moves = board.generateMoves<side>();
+    if (moves == 0) {
+        if (passed) return finalScore(board, side);
+        return -negamax<opponent(side)>(board, depth, -beta, -alpha, true);
+    }
+    if (depth <= 0) return evaluate(board, side);
+
+    int cut;
+    if (selective && probCut<side>(board, depth, alpha, beta, passed, &cut)) {
+        return cut;
+    }
+    if (stopped) return 0;
+
+    int ply = feat - featureStack;
+    int order[NUM_OTHELLO_SQUARES * NUM_OTHELLO_SQUARES];
+    int numMoves = ordering.order(board, side, moves, hashMove, ply, depth,
+                                  order);
+
+    int alphaOrig = alpha;
+    int best = -SCORE_INF;
+    int bestSq = TT_NO_MOVE;
+    for (int i = 0; i < numMoves; i++) {
+        int sq = order[i];
+        uint64_t flipped;
+        makeMove<side>(board, sq, &flipped);
+        int score = -negamax<opponent(side)>(board, depth - 1, -beta, -alpha,
+                                             false);
+        unmakeMove<side>(board, sq, flipped);
+        if (stopped) return 0;
+
+        if (score > best) {
+            best = score;
+            bestSq = sq;
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) {
+                    ordering.cutoff(side, sq, ply, depth, i);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (table != nullptr) {
+        // A fail-low node has no trustworthy best move.
+        if (best <= alphaOrig) {
+            table->store(key, depth, BOUND_UPPER, best, TT_NO_MOVE);
+        } else {
+            int bound = (best >= beta) ? BOUND_LOWER : BOUND_EXACT;
+            table->store(key, depth, bound, best,
+                         transformSquare(bestSq, symmetry));
+        }
+    }
+    return best;
+}
+
+/*
+ * Multi-ProbCut: a shallow search, mapped through the calibrated linear
+ * relation between shallow and deep results, predicts whether the full
+ * search would fail high or low. If the prediction clears the bound by
+ * MPC_THRESHOLD standard deviations, the node is cut without the deep
+ * search and *score is the bound. Returns false if the node must be
+ * searched.
+ */
+template <Side side>
+bool Search::probCut(Board &board, int depth, int alpha, int beta,
+                     bool passed, int *score) {
+    const MpcParams *mpc = evalMpc(64 - popCount(board.getTaken()), depth);
+    if (mpc == nullptr || mpc->slope <= 0) return false;
+    if (beta >= SCORE_WIN || alpha <= -SCORE_WIN) return false;
+
+    int shallow = mpcShallowDepth(depth);
+    double margin = MPC_THRESHOLD * mpc->sigma;
+
+    int bound = (int)lround((beta + margin - mpc->offset) / mpc->slope);
+    if (bound < SCORE_WIN &&
+        negamax<side>(board, shallow, bound - 1, bound, passed) >= bound) {
+        probCuts++;
+        *score = beta;
+        return !stopped;
+    }
+    if (stopped) return false;
+
+    bound = (int)lround((alpha - margin - mpc->offset) / mpc->slope);
+    if (bound > -SCORE_WIN &&
+        negamax<side>(board, shallow, bound, bound + 1, passed) <= bound) {
+        probCuts++;
+        *score = alpha;
+        return !stopped;
+    }
+    return false;
+}
+
+/*
+ * Plays a move on the board and pushes the updated pattern features.
+ */
+template <Side side>
+void Search::makeMove(Board &board, int sq, uint64_t *flipped) {
+    *flipped = board.makeMove<side>(sq);
+    feat[1] = feat[0];
+    feat++;
+    evalUpdate(feat, sq, *flipped, side);
+}
+
+/*
+ * Takes back makeMove.
+ */
+template <Side side>
+void Search::unmakeMove(Board &board, int sq, uint64_t flipped) {
+    board.unmakeMove<side>(sq, flipped);
+    feat--;
+}
+
+/*
+ * Transposition table key of the position. Moves go into the table mapped
+ * by *symmetry and come out mapped by its inverse; without canonical keys
+ * it is the identity.
+ */
+uint64_t Search::tableKey(const Board &board, Side side, int *symmetry) {
+    if (canonical) return board.getCanonicalHash(side, symmetry);
+    *symmetry = 0;
+    return board.getHash(side);
+}
+
+/*
+ * Static evaluation for `side`, from the incrementally kept features.
+ */
+int Search::evaluate(const Board &board, Side side) {
+    return evalScore(*feat, 64 - popCount(board.getTaken()), side);
+}
+
+/*
+ * Score of a finished game for `side`.
+ */
+int Search::finalScore(const Board &board, Side side) {
+    int diff = popCount(board.getPieces(side)) -
+               popCount(board.getPieces(opponent(side)));
+    if (diff > 0) return SCORE_WIN + diff;
+    if (diff < 0) return -SCORE_WIN + diff;
+    return 0;
+}
+
+bool Search::timeUp() {
+    return chrono::steady_clock::now() >= deadline;
+}
+
+/*
+ * True once the deadline has passed or the owner has raised the stop flag.
+ * The main search's first iteration ignores both.
+ */
+bool Search::shouldStop() {
+    if (!interruptible) return false;
+    if (stopFlag != nullptr && stopFlag->load(memory_order_relaxed)) {
+        return true;
+    }
+    return limited && timeUp();
+}
@@ -0,0 +1,111 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "common.hpp"
+#include "board.hpp"
+#include "tt.hpp"
+#include "eval.hpp"
+#include "timectl.hpp"
+#include "ordering.hpp"
+#include "stats.hpp"
+
+#define SEARCH_MAX_DEPTH 60
+
+// Bounds for search scores. A finished game scores SCORE_WIN plus the disc
+// differential, which keeps it above anything the evaluation returns.
+static const int SCORE_INF = 30000;
+static const int SCORE_WIN = 20000;
+
+class Search {
+
+public:
+    Search();
+    ~Search();
+
+    void setTable(TranspositionTable *table) { this->table = table; }
+    void setStopFlag(std::atomic<bool> *flag) { this->stopFlag = flag; }
+    void setHelper(int id) { this->helperId = id; }
+    void setTimeControl(TimeControl *clock) { this->clock = clock; }
+    void setSelective(bool on) { this->selective = on; }
+    void setCanonical(bool on) { this->canonical = on; }
+    int run(const Board &board, Side side, int maxDepth, int msBudget);
+
+    int getMove() { return bestMove; }
+    int getScore() { return bestScore; }
+    int getDepth() { return depthReached; }
+    uint64_t getNodes() { return nodes; }
+    // Move-ordering statistics of the last run.
+    uint64_t getCutoffs() { return ordering.getCutoffs(); }
+    uint64_t getFirstCutoffs() { return ordering.getFirstCutoffs(); }
+    uint64_t getProbCuts() { return probCuts; }
+    // Table lookups of the last run, and those that found the position.
+    uint64_t getTableProbes() { return tableProbes; }
+    uint64_t getTableHits() { return tableHits; }
+    int getPV(const Board &board, Side side, int first, int *pv,
+              int maxLength);
+
+private:
+    // The tree is searched by functions specialised on the side to move.
+    template <Side side>
+    int searchRoot(Board &board, int depth, int *rootMoves, int numMoves);
+    template <Side side>
+    int negamax(Board &board, int depth, int alpha, int beta, bool passed);
+    template <Side side>
+    bool probCut(Board &board, int depth, int alpha, int beta, bool passed,
+                 int *score);
+    uint64_t tableKey(const Board &board, Side side, int *symmetry);
+    int evaluate(const Board &board, Side side);
+    template <Side side>
+    void makeMove(Board &board, int sq, uint64_t *flipped);
+    template <Side side>
+    void unmakeMove(Board &board, int sq, uint64_t flipped);
+    int finalScore(const Board &board, Side side);
+    bool timeUp();
+    bool shouldStop();
+
+    // Shared transposition table; may be null.
+    TranspositionTable *table;
+    // Raised by whoever owns the search to stop it early; may be null.
+    std::atomic<bool> *stopFlag;
+    // 0 for the main search; helper threads of a parallel search number
+    // from 1 and vary their iterations so they don't all duplicate it.
+    int helperId;
+    // Sets the main search's time limits instead of msBudget; may be null.
+    TimeControl *clock;
+
+    // Prune with Multi-ProbCut where the weight file has parameters.
+    bool selective;
+
+    // Key the table on canonical positions, so all 8 orientations of a
+    // position share an entry; moves are stored in canonical orientation.
+    bool canonical;
+
+    // Killers and history of this thread's search.
+    MoveOrder ordering;
+
+    // Pattern features of each position on the current line; feat points at
+    // the entry for the node being searched.
+    EvalFeatures featureStack[SEARCH_MAX_DEPTH + 2];
+    EvalFeatures *feat;
+
+    // Time limit for the current run, if there is one.
+    std::chrono::steady_clock::time_point deadline;
+    bool limited;
+    // False while the main search runs its first iteration.
+    bool interruptible;
+    // Set once the deadline passes; the running iteration is then discarded.
+    bool stopped;
+
+    uint64_t nodes;
+    uint64_t probCuts;
+    uint64_t tableProbes;
+    uint64_t tableHits;
+    int bestMove;
+    int bestScore;
+    int depthReached;
+};
+
+#endif
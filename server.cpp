@@ -0,0 +1,388 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.hpp"
+#include "player.hpp"
+
+using namespace std;
+
+/*
+ * One game of a session and the player that plays it.
+ */
+struct Game {
+    Player *player;
+    // Settings from MSG_NEW_GAME, reapplied when the position is set.
+    Side side;
+    AI_t ai;
+    int threads;
+    size_t ttMegabytes;
+
+    // Opponent move for the next go, if one has arrived.
+    Move pending;
+    bool hasPending;
+    bool passPending;
+
+    // A go is running on worker; guarded by lock.
+    bool running;
+    thread worker;
+    mutex lock;
+
+    Game() : pending(-1, -1) {
+        player = nullptr;
+        hasPending = false;
+        passPending = false;
+        running = false;
+    }
+};
+
+/*
+ * A session: reads requests in order, and answers each go from the thread
+ * that ran it.
+ */
+class Session {
+
+public:
+    Session(int in, int out);
+    ~Session();
+
+    void run();
+
+private:
+    bool receive(ProtocolMessage *message);
+    void send(const ProtocolMessage &message);
+    void reply(const ProtocolMessage &request, int error);
+    void handle(const ProtocolMessage &request);
+    void newGame(const ProtocolMessage &request);
+    void setPosition(Game *game, const ProtocolMessage &request);
+    void move(Game *game, const ProtocolMessage &request);
+    void go(Game *game, const ProtocolMessage &request);
+    void search(Game *game, uint32_t id, int msLeft);
+    void endGame(uint32_t id);
+    Player *makePlayer(const Game *game, Board *board);
+
+    int in;
+    int out;
+    mutex writeLock;
+    // Only the reading thread adds and removes games.
+    map<uint32_t, Game *> games;
+};
+
+Session::Session(int in, int out) {
+    this->in = in;
+    this->out = out;
+}
+
+Session::~Session() {
+    while (!games.empty()) {
+        endGame(games.begin()->first);
+    }
+}
+
+/*
+ * Serves requests until the client closes its end.
+ */
+void Session::run() {
+    ProtocolMessage hello;
+    memset(&hello, 0, sizeof(hello));
+    hello.type = MSG_HELLO;
+    hello.value = PROTOCOL_VERSION;
+    send(hello);
+
+    ProtocolMessage request;
+    while (receive(&request)) {
+        handle(request);
+    }
+}
+
+/*
+ * Reads one whole frame; false at end of input or on an error.
+ */
+bool Session::receive(ProtocolMessage *message) {
+    char *p = (char *)message;
+    size_t left = sizeof(*message);
+    while (left > 0) {
+        ssize_t n = read(in, p, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+/*
+ * Writes one frame. Go threads and the reading thread share the output.
+ */
+void Session::send(const ProtocolMessage &message) {
+    lock_guard<mutex> guard(writeLock);
+    const char *p = (const char *)&message;
+    size_t left = sizeof(message);
+    while (left > 0) {
+        ssize_t n = write(out, p, left);
+        if (n < 0 && errno == EINTR) continue;
+        // The client is gone; the reading thread will notice.
+        if (n <= 0) return;
+        p += n;
+        left -= n;
+    }
+}
+
+void Session::reply(const ProtocolMessage &request, int error) {
+    ProtocolMessage answer;
+    memset(&answer, 0, sizeof(answer));
+    answer.type = (error == PROTOCOL_OK) ? MSG_OK : MSG_ERROR;
+    answer.option = error;
+    answer.game = request.game;
+    send(answer);
+}
+
+void Session::handle(const ProtocolMessage &request) {
+    if (request.type == MSG_NEW_GAME) {
+        newGame(request);
+        return;
+    }
+    if (request.type < MSG_NEW_GAME || request.type > MSG_END_GAME) {
+        reply(request, PROTOCOL_UNKNOWN_TYPE);
+        return;
+    }
+
+    map<uint32_t, Game *>::iterator found = games.find(request.game);
+    if (found == games.end()) {
+        reply(request, PROTOCOL_NO_GAME);
+        return;
+    }
+    Game *game = found->second;
+
+    switch (request.type) {
+    case MSG_SET_POSITION:
+        setPosition(game, request);
+        break;
+    case MSG_MOVE:
+        move(game, request);
+        break;
+    case MSG_GO:
+        go(game, request);
+        break;
+    case MSG_STOP:
+    {
+        lock_guard<mutex> guard(game->lock);
+        if (game->running) game->player->requestStop();
+        break;
+    }
+    case MSG_END_GAME:
+        endGame(request.game);
+        reply(request, PROTOCOL_OK);
+        break;
+    }
+}
+
+Player *Session::makePlayer(const Game *game, Board *board) {
+    Player *player = (board != nullptr)
+        ? new Player(game->side, board, game->ttMegabytes)
+        : new Player(game->side, game->ttMegabytes);
+    player->AI_type = game->ai;
+    player->setThreads(game->threads);
+    return player;
+}
+
+void Session::newGame(const ProtocolMessage &request) {
+    if (games.count(request.game)) {
+        reply(request, PROTOCOL_GAME_EXISTS);
+        return;
+    }
+
+    Game *game = new Game();
+    game->side = (request.side == BLACK) ? BLACK : WHITE;
+    game->ai = (request.option <= ALPHABETA_AI) ? (AI_t)request.option
+                                                : ALPHABETA_AI;
+    game->threads = (request.value > 1) ? request.value : 1;
+    game->ttMegabytes = (request.extra > 0) ? request.extra : DEFAULT_TT_MB;
+    game->player = makePlayer(game, nullptr);
+    games[request.game] = game;
+    reply(request, PROTOCOL_OK);
+}
+
+void Session::setPosition(Game *game, const ProtocolMessage &request) {
+    lock_guard<mutex> guard(game->lock);
+    if (game->running) {
+        reply(request, PROTOCOL_BUSY);
+        return;
+    }
+    if (request.black & request.white) {
+        reply(request, PROTOCOL_BAD_MOVE);
+        return;
+    }
+
+    Board *board = new Board();
+    board->setPieces(request.black, request.white);
+    delete game->player;
+    game->player = makePlayer(game, board);
+    game->hasPending = false;
+    game->passPending = false;
+    reply(request, PROTOCOL_OK);
+}
+
+void Session::move(Game *game, const ProtocolMessage &request) {
+    lock_guard<mutex> guard(game->lock);
+    if (game->running) {
+        reply(request, PROTOCOL_BUSY);
+        return;
+    }
+    if (request.square > PROTOCOL_PASS ||
+        game->hasPending || game->passPending) {
+        reply(request, PROTOCOL_BAD_MOVE);
+        return;
+    }
+    // Player plays the move without checking it, so an illegal one would
+    // corrupt the board; a pass is only legal without a move to make.
+    int square = (request.square == PROTOCOL_PASS) ? -1 : request.square;
+    if (!game->player->checkTheirMove(square)) {
+        reply(request, PROTOCOL_BAD_MOVE);
+        return;
+    }
+
+    if (request.square == PROTOCOL_PASS) {
+        game->passPending = true;
+    } else {
+        game->pending.setX(request.square % NUM_OTHELLO_SQUARES);
+        game->pending.setY(request.square / NUM_OTHELLO_SQUARES);
+        game->hasPending = true;
+    }
+    reply(request, PROTOCOL_OK);
+}
+
+/*
+ * Starts the engine's move on its own thread. A stop that arrives before
+ * the search begins still counts, since the request is cleared here, under
+ * the lock the stop is raised under.
+ */
+void Session::go(Game *game, const ProtocolMessage &request) {
+    lock_guard<mutex> guard(game->lock);
+    if (game->running) {
+        reply(request, PROTOCOL_BUSY);
+        return;
+    }
+    // The last go's thread has finished; collect it.
+    if (game->worker.joinable()) game->worker.join();
+
+    game->player->clearStopRequest();
+    game->running = true;
+    game->worker = thread(&Session::search, this, game, request.game,
+                          (int)request.value);
+}
+
+/*
+ * Body of a go thread.
+ */
+void Session::search(Game *game, uint32_t id, int msLeft) {
+    Move *opponentsMove = game->hasPending ? &game->pending : nullptr;
+    game->hasPending = false;
+    game->passPending = false;
+
+    Move *ours = game->player->doMove(opponentsMove, msLeft);
+
+    ProtocolMessage answer;
+    memset(&answer, 0, sizeof(answer));
+    answer.type = MSG_BEST_MOVE;
+    answer.game = id;
+    answer.square = (ours == nullptr)
+        ? PROTOCOL_PASS : ours->x + NUM_OTHELLO_SQUARES * ours->y;
+#if SEARCH_STATS
+    const MoveStats &stats = game->player->getMoveStats();
+    answer.option = (stats.depth < 255) ? stats.depth : 255;
+    answer.value = stats.score;
+    answer.extra = (uint32_t)stats.ms;
+#endif
+
+    {
+        lock_guard<mutex> guard(game->lock);
+        game->running = false;
+    }
+    send(answer);
+}
+
+/*
+ * Stops the game's search if it is running, and forgets the game.
+ */
+void Session::endGame(uint32_t id) {
+    map<uint32_t, Game *>::iterator found = games.find(id);
+    if (found == games.end()) return;
+    Game *game = found->second;
+
+    {
+        lock_guard<mutex> guard(game->lock);
+        if (game->running) game->player->requestStop();
+    }
+    if (game->worker.joinable()) game->worker.join();
+    delete game->player;
+    delete game;
+    games.erase(found);
+}
+
+/*
+ * Serves one session over a pair of file descriptors, such as a pipe pair.
+ */
+int serveStream(int in, int out) {
+    // A client that goes away shows up as a failed write, not a signal.
+    signal(SIGPIPE, SIG_IGN);
+    Session session(in, out);
+    session.run();
+    return 0;
+}
+
+static void serveConnection(int fd) {
+    {
+        Session session(fd, fd);
+        session.run();
+    }
+    close(fd);
+}
+
+/*
+ * Listens on a Unix socket at path (replacing a stale one) and serves every
+ * connection as its own session, until the process is killed.
+ */
+int serveSocket(const char *path) {
+    signal(SIGPIPE, SIG_IGN);
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(address.sun_path, path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+    unlink(path);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listener, 16) != 0) {
+        perror(path);
+        close(listener);
+        return 1;
+    }
+
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            break;
+        }
+        thread(serveConnection, fd).detach();
+    }
+    close(listener);
+    return 1;
+}
@@ -0,0 +1,83 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <cstdint>
+
+/*
+ * Binary driver protocol. One engine process serves any number of games at
+ * once, for a tournament runner that would otherwise start a wrapper
+ * process per player per game. It is spoken over a pipe pair (stdin and
+ * stdout) or over connections to a Unix socket; on a socket, every
+ * connection has its own set of games.
+ *
+ * Both directions carry fixed-size ProtocolMessage frames in host byte
+ * order. The server opens with MSG_HELLO. After that every request is
+ * answered with MSG_OK or MSG_ERROR, except MSG_GO, answered by
+ * MSG_BEST_MOVE once the engine has moved, and MSG_STOP, which only makes
+ * that answer come sooner. Games are named by ids the client picks, and
+ * searches of different games run in parallel, so answers to MSG_GO can
+ * arrive in any order.
+ *
+ * The engine keeps the board itself as in text mode: after MSG_NEW_GAME
+ * (or MSG_SET_POSITION), the client sends each opponent move with MSG_MOVE
+ * and then MSG_GO for ours. A game where the opponent moves first starts
+ * with MSG_MOVE; when the opponent passes, MSG_GO alone is enough.
+ */
+
+#define PROTOCOL_VERSION 1
+// Square of a pass in MSG_MOVE and MSG_BEST_MOVE.
+#define PROTOCOL_PASS 64
+
+enum MessageType {
+    // Server: first frame of a session. value is PROTOCOL_VERSION.
+    MSG_HELLO = 1,
+    // side is the engine's Side, option its AI_t, value the search threads
+    // (0 for 1) and extra the table size in MB (0 for the default).
+    MSG_NEW_GAME,
+    // Restarts the game from black/white discs, keeping its settings.
+    MSG_SET_POSITION,
+    // square is the opponent's move, or PROTOCOL_PASS.
+    MSG_MOVE,
+    // value is the engine's time left in ms, or -1 for none.
+    MSG_GO,
+    // Cuts the game's running MSG_GO short.
+    MSG_STOP,
+    MSG_END_GAME,
+
+    // Server replies.
+    MSG_OK,
+    // option is a ProtocolError.
+    MSG_ERROR,
+    // square is the engine's move (or PROTOCOL_PASS), option the depth
+    // reached, value the score and extra the time taken in ms.
+    MSG_BEST_MOVE
+};
+
+enum ProtocolError {
+    PROTOCOL_OK,
+    PROTOCOL_UNKNOWN_TYPE,
+    PROTOCOL_NO_GAME,
+    PROTOCOL_GAME_EXISTS,
+    // The game is searching; only MSG_STOP and MSG_END_GAME are allowed.
+    PROTOCOL_BUSY,
+    // Not a square, an occupied square or one that flips nothing, a pass
+    // while a move is possible, or a second opponent move before MSG_GO.
+    PROTOCOL_BAD_MOVE
+};
+
+struct ProtocolMessage {
+    uint8_t type;
+    uint8_t side;
+    uint8_t square;
+    uint8_t option;
+    uint32_t game;
+    int32_t value;
+    uint32_t extra;
+    uint64_t black;
+    uint64_t white;
+};
+
+int serveStream(int in, int out);
+int serveSocket(const char *path);
+
+#endif
@@ -0,0 +1,86 @@
+#include <cstring>
+#include "stats.hpp"
+
+using namespace std;
+
+/*
+ * Writes a square in the usual notation: column a-h (x), row 1-8 (y).
+ */
+void squareName(int sq, char *out) {
+    if (sq < 0 || sq >= 64) {
+        strcpy(out, "pass");
+        return;
+    }
+    out[0] = 'a' + sq % NUM_OTHELLO_SQUARES;
+    out[1] = '1' + sq / NUM_OTHELLO_SQUARES;
+    out[2] = '\0';
+}
+
+static double rate(uint64_t part, uint64_t whole) {
+    return (whole > 0) ? (double)part / whole : 0.0;
+}
+
+static double nodesPerSecond(const MoveStats &stats) {
+    return (stats.ms > 0) ? stats.nodes * 1000.0 / stats.ms : 0.0;
+}
+
+/*
+ * Resets everything, for a move nothing has been recorded for yet.
+ */
+void statsClear(MoveStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->move = STATS_PASS;
+    stats->source = "none";
+    stats->msLeft = -1;
+}
+
+/*
+ * One line of key=value pairs, prefixed "stats", ending in the PV.
+ */
+void statsPrint(FILE *file, const MoveStats &stats) {
+    char name[8];
+    squareName(stats.move, name);
+    fprintf(file, "stats move=%d side=%s square=%s source=%s empties=%d "
+                  "depth=%d score=%d nodes=%llu ms=%.1f nps=%.0f "
+                  "ms_left=%d tt_hit_rate=%.3f cutoffs=%llu "
+                  "first_cutoff_rate=%.3f probcuts=%llu pv=",
+            stats.number, (stats.side == BLACK) ? "black" : "white", name,
+            stats.source, stats.empties, stats.depth, stats.score,
+            (unsigned long long)stats.nodes, stats.ms, nodesPerSecond(stats),
+            stats.msLeft, rate(stats.ttHits, stats.ttProbes),
+            (unsigned long long)stats.cutoffs,
+            rate(stats.firstCutoffs, stats.cutoffs),
+            (unsigned long long)stats.probCuts);
+    for (int i = 0; i < stats.pvLength; i++) {
+        squareName(stats.pv[i], name);
+        fprintf(file, (i > 0) ? ",%s" : "%s", name);
+    }
+    fprintf(file, "\n");
+}
+
+/*
+ * The same as a JSON object on one line.
+ */
+void statsWriteJson(FILE *file, const MoveStats &stats) {
+    char name[8];
+    squareName(stats.move, name);
+    fprintf(file, "{\"move\":%d,\"side\":\"%s\",\"square\":\"%s\","
+                  "\"source\":\"%s\",\"empties\":%d,\"depth\":%d,"
+                  "\"score\":%d,\"nodes\":%llu,\"ms\":%.1f,\"nps\":%.0f,"
+                  "\"ms_left\":%d,\"tt_probes\":%llu,\"tt_hits\":%llu,"
+                  "\"cutoffs\":%llu,\"first_cutoffs\":%llu,"
+                  "\"probcuts\":%llu,\"pv\":[",
+            stats.number, (stats.side == BLACK) ? "black" : "white", name,
+            stats.source, stats.empties, stats.depth, stats.score,
+            (unsigned long long)stats.nodes, stats.ms, nodesPerSecond(stats),
+            stats.msLeft, (unsigned long long)stats.ttProbes,
+            (unsigned long long)stats.ttHits,
+            (unsigned long long)stats.cutoffs,
+            (unsigned long long)stats.firstCutoffs,
+            (unsigned long long)stats.probCuts);
+    for (int i = 0; i < stats.pvLength; i++) {
+        squareName(stats.pv[i], name);
+        fprintf(file, (i > 0) ? ",\"%s\"" : "\"%s\"", name);
+    }
+    fprintf(file, "]}\n");
+}
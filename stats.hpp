@@ -0,0 +1,68 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <cstdint>
+#include <cstdio>
+#include "common.hpp"
+
+/*
+ * Search statistics. Player fills in a MoveStats for every doMove call and
+ * can report it as a key=value line on stderr and as a JSON object per line
+ * in a game log.
+ *
+ * SEARCH_STATS (make STATS=0 turns it off) compiles in the per-node
+ * counters and the reports. Without it STATS_COUNT expands to nothing, so
+ * the search does exactly the work it would with no statistics at all.
+ */
+#ifndef SEARCH_STATS
+#define SEARCH_STATS 1
+#endif
+
+#if SEARCH_STATS
+#define STATS_COUNT(counter) ((counter)++)
+#else
+#define STATS_COUNT(counter) ((void)0)
+#endif
+
+// Longest principal variation kept.
+#define STATS_MAX_PV 24
+// Marks a pass in a principal variation.
+#define STATS_PASS -1
+
+/*
+ * What one doMove call did.
+ */
+struct MoveStats {
+    // Our moves so far this game, this one included.
+    int number;
+    Side side;
+    // Square played, or STATS_PASS.
+    int move;
+    // What chose it: "book", "forced", "search", "endgame", or an AI name.
+    const char *source;
+    int empties;
+    // Depth of the last completed iteration; for the endgame, the empties.
+    int depth;
+    // Search score in evaluation units, or the exact disc differential.
+    int score;
+    uint64_t nodes;
+    double ms;
+    // Clock left when the call started; -1 if untimed.
+    int msLeft;
+    uint64_t ttProbes;
+    uint64_t ttHits;
+    uint64_t cutoffs;
+    uint64_t firstCutoffs;
+    uint64_t probCuts;
+    // Expected line from the move played on, alternating sides.
+    int pv[STATS_MAX_PV];
+    int pvLength;
+};
+
+// Square in the usual notation ("d3"), or "pass"; out holds 5 characters.
+void squareName(int sq, char *out);
+void statsClear(MoveStats *stats);
+void statsPrint(FILE *file, const MoveStats &stats);
+void statsWriteJson(FILE *file, const MoveStats &stats);
+
+#endif
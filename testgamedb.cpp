@@ -0,0 +1,145 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+#include "common.hpp"
+#include "board.hpp"
+#include "gamedb.hpp"
+
+using namespace std;
+
+/*
+ * Checks the game file round trip: random games, passes included, are
+ * appended with GameWriter, a torn record is left at the end as a crash
+ * would, and after one more append the file is mapped with GameDatabase
+ * and every game replayed with gameReplay.
+ *
+ *   testgamedb [scratch-file]
+ *
+ * Prints one line per check and exits non-zero if any fails.
+ */
+
+static const int NUM_GAMES = 200;
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok) failures++;
+}
+
+/*
+ * Plays random legal moves, passing when forced, until the game ends or
+ * `plies` moves are made. Returns the record and leaves the last position
+ * in *board.
+ */
+static GameRecord randomGame(int plies, Board *board) {
+    GameRecord game;
+    gameClear(&game);
+    *board = Board();
+    Side side = BLACK;
+    for (int i = 0; i < plies; i++) {
+        uint64_t moves = board->generateMoves(side);
+        if (moves == 0) {
+            side = opponent(side);
+            moves = board->generateMoves(side);
+            if (moves == 0) break;
+        }
+        int n = rand() % popCount(moves);
+        while (n-- > 0) moves &= moves - 1;
+        int sq = firstSquare(moves);
+        board->makeMove(sq, side);
+        gamePush(&game, sq);
+        side = opponent(side);
+    }
+    gameFinish(&game, *board, 0);
+    return game;
+}
+
+static bool sameGame(const GameRecord &a, const GameRecord &b) {
+    if (a.numMoves != b.numMoves || a.result != b.result ||
+        a.flags != b.flags) {
+        return false;
+    }
+    for (int i = 0; i < a.numMoves; i++) {
+        if (a.moves[i] != b.moves[i]) return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = (argc > 1) ? argv[1] : "testgamedb.games";
+    unlink(path);
+    srand(1);
+
+    vector<GameRecord> games;
+    vector<Board> ends;
+    GameWriter writer;
+    check(writer.open(path), "create a game file");
+    bool appended = true;
+    for (int g = 0; g < NUM_GAMES; g++) {
+        // Every tenth game is cut off early.
+        Board board;
+        games.push_back(randomGame((g % 10 == 0) ? 20 : 60, &board));
+        ends.push_back(board);
+        appended = writer.append(games.back()) && appended;
+    }
+    check(appended, "append games");
+    writer.close();
+
+    // Half a record, as left by a writer that died mid-append.
+    int fd = open(path, O_WRONLY | O_APPEND);
+    bool torn = fd >= 0 &&
+                write(fd, &games[0], sizeof(GameRecord) / 2) ==
+                    (ssize_t)(sizeof(GameRecord) / 2);
+    if (fd >= 0) close(fd);
+    check(torn, "leave a torn record");
+
+    GameDatabase partial;
+    check(partial.load(path) && partial.getSize() == games.size(),
+          "reader skips the torn record");
+
+    Board board;
+    games.push_back(randomGame(60, &board));
+    ends.push_back(board);
+    check(writer.open(path) && writer.append(games.back()),
+          "reopen and append after the torn record");
+    writer.close();
+
+    GameDatabase database;
+    check(database.load(path) && database.getSize() == games.size(),
+          "load every game");
+
+    bool same = true, replayed = true, finished = true;
+    for (size_t g = 0; g < games.size() && g < database.getSize(); g++) {
+        const GameRecord &game = database.getGame(g);
+        same = same && sameGame(game, games[g]);
+
+        Board end;
+        Side side;
+        replayed = replayed &&
+                   gameReplay(game, &end, &side, -1) == game.numMoves &&
+                   end.getPieces(BLACK) == ends[g].getPieces(BLACK) &&
+                   end.getPieces(WHITE) == ends[g].getPieces(WHITE);
+        bool over = (end.generateMoves(BLACK) | end.generateMoves(WHITE)) == 0;
+        finished = finished && over == !(game.flags & GAME_UNFINISHED);
+    }
+    check(same, "records read back unchanged");
+    check(replayed, "replays reach the recorded positions");
+    check(finished, "unfinished games are flagged");
+
+    // A record with an illegal move replays up to it.
+    GameRecord broken = games[1];
+    broken.moves[5] = broken.moves[4];
+    Side side;
+    check(gameReplay(broken, &board, &side, -1) == 5,
+          "replay stops at an illegal move");
+
+    unlink(path);
+    if (failures > 0) {
+        printf("%d game file checks failed\n", failures);
+        return 1;
+    }
+    printf("All game file checks passed\n");
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "common.hpp"
+#include "board.hpp"
+#include "learn.hpp"
+
+using namespace std;
+
+/*
+ * Checks the learned-results file: a save and load round trip, merging
+ * with what another process saved, the capacity bound, and that damaged
+ * files are refused.
+ *
+ *   testlearn [scratch-file]
+ *
+ * Prints one line per check and exits non-zero if any fails.
+ */
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok) failures++;
+}
+
+/*
+ * Distinct positions from random play, one per ply of a few games.
+ */
+static vector<Board> randomPositions(int count) {
+    vector<Board> positions;
+    while ((int)positions.size() < count) {
+        Board board;
+        Side side = BLACK;
+        for (int ply = 0; ply < 50 && (int)positions.size() < count; ply++) {
+            uint64_t moves = board.generateMoves(side);
+            if (moves == 0) break;
+            int n = rand() % popCount(moves);
+            while (n-- > 0) moves &= moves - 1;
+            board.makeMove(firstSquare(moves), side);
+            side = opponent(side);
+            positions.push_back(board);
+        }
+    }
+    return positions;
+}
+
+static const LearnedEntry *find(const LearnedCache &cache, const Board &board) {
+    uint64_t black, white;
+    board.canonicalForm(&black, &white);
+    for (size_t i = 0; i < cache.getSize(); i++) {
+        const LearnedEntry &entry = cache.getEntry(i);
+        if (entry.black == black && entry.white == white) return &entry;
+    }
+    return nullptr;
+}
+
+static bool writeFile(const char *path, const void *data, size_t size) {
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) return false;
+    bool ok = fwrite(data, 1, size, file) == size;
+    return (fclose(file) == 0) && ok;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = (argc > 1) ? argv[1] : "testlearn.learn";
+    string tempPath = string(path) + ".tmp";
+    string lockPath = string(path) + ".lock";
+    unlink(path);
+    srand(1);
+    vector<Board> positions = randomPositions(60);
+
+    // Round trip; the first position is too shallow to keep.
+    LearnedCache first;
+    first.record(positions[0], BLACK, LEARN_MIN_DEPTH - 1, 10, 19, false);
+    for (int i = 1; i < 20; i++) {
+        first.record(positions[i], (Side)(i % 2), LEARN_MIN_DEPTH + i % 5,
+                     i * 3, i % 64, i % 4 == 0);
+    }
+    check(first.getSize() == 19, "shallow results are not kept");
+    check(first.save(path), "save");
+    check(access(tempPath.c_str(), F_OK) != 0, "no temporary file left");
+
+    LearnedCache loaded;
+    check(loaded.load(path) && loaded.getSize() == first.getSize(),
+          "load what was saved");
+    bool same = true;
+    for (size_t i = 0; i < first.getSize(); i++) {
+        const LearnedEntry &entry = first.getEntry(i);
+        Board board;
+        board.setPieces(entry.black, entry.white);
+        const LearnedEntry *found = find(loaded, board);
+        same = same && found != nullptr &&
+               memcmp(found, &entry, sizeof(entry)) == 0;
+    }
+    check(same, "entries read back unchanged");
+    check(loaded.touch(positions[5].transform(3), (Side)(5 % 2)),
+          "any orientation finds an entry");
+
+    // Two players that loaded the same file save in turn: the second keeps
+    // the first's results, and the deeper of two results for a position.
+    LearnedCache a, b;
+    a.load(path);
+    b.load(path);
+    a.record(positions[30], BLACK, LEARN_MIN_DEPTH, 5, 20, false);
+    a.record(positions[31], WHITE, LEARN_MIN_DEPTH, 6, 21, false);
+    b.record(positions[31], WHITE, LEARN_MIN_DEPTH + 4, -6, 22, false);
+    b.record(positions[32], BLACK, LEARN_MIN_DEPTH, 7, 23, false);
+    check(a.save(path) && b.save(path), "two saves of one file");
+    LearnedCache merged;
+    merged.load(path);
+    const LearnedEntry *deeper = find(merged, positions[31]);
+    check(merged.getSize() == first.getSize() + 3 &&
+          find(merged, positions[30]) != nullptr &&
+          find(merged, positions[32]) != nullptr,
+          "a save merges with the file");
+    check(deeper != nullptr && deeper->depth == LEARN_MIN_DEPTH + 4,
+          "the deeper result is kept");
+
+    // Capacity: the deepest entries are kept.
+    unlink(path);
+    LearnedCache full;
+    for (int i = 0; i < 40; i++) {
+        full.record(positions[i], BLACK, LEARN_MIN_DEPTH + i, 0, 0, false);
+    }
+    check(full.save(path, 10) && full.getSize() == 10, "save to a capacity");
+    LearnedCache bounded;
+    bool deepest = bounded.load(path) && bounded.getSize() == 10;
+    for (size_t i = 0; i < bounded.getSize(); i++) {
+        deepest = deepest && bounded.getEntry(i).depth >= LEARN_MIN_DEPTH + 30;
+    }
+    check(deepest, "only the deepest entries are kept");
+
+    // Damaged files.
+    LearnedFileHeader header;
+    FILE *file = fopen(path, "rb");
+    bool read = file != nullptr &&
+                fread(&header, sizeof(header), 1, file) == 1;
+    if (file != nullptr) fclose(file);
+    header.count = 0xffffffff;
+    LearnedCache damaged;
+    check(read && writeFile(path, &header, sizeof(header)) &&
+          !damaged.load(path) && damaged.getSize() == 0,
+          "a count larger than the file is refused");
+
+    header.count = 2;
+    vector<char> shortFile(sizeof(header) + sizeof(LearnedEntry) + 5);
+    memcpy(shortFile.data(), &header, sizeof(header));
+    check(writeFile(path, shortFile.data(), shortFile.size()) &&
+          !damaged.load(path) && damaged.getSize() == 0,
+          "a truncated file is refused");
+    check(!damaged.load("/nonexistent/testlearn"), "a missing file is refused");
+
+    unlink(path);
+    unlink(lockPath.c_str());
+    if (failures > 0) {
+        printf("%d learned-results checks failed\n", failures);
+        return 1;
+    }
+    printf("All learned-results checks passed\n");
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+#include "common.hpp"
+#include "board.hpp"
+#include "player.hpp"
+#include "server.hpp"
+
+using namespace std;
+
+/*
+ * Checks the binary driver protocol. A session is served over a pipe pair
+ * in this process, and one game is played through new game, move, go,
+ * stop and end game, along with a request of every kind that must fail.
+ * Prints one line per check and exits non-zero if any fails.
+ */
+
+static int toServer;
+static int fromServer;
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok) failures++;
+}
+
+static void send(uint8_t type, uint32_t game, uint8_t square = 0,
+                 int32_t value = 0) {
+    ProtocolMessage message;
+    memset(&message, 0, sizeof(message));
+    message.type = type;
+    message.game = game;
+    message.square = square;
+    message.value = value;
+    if (write(toServer, &message, sizeof(message)) != sizeof(message)) {
+        perror("write");
+    }
+}
+
+static ProtocolMessage receive() {
+    ProtocolMessage message;
+    memset(&message, 0, sizeof(message));
+    char *p = (char *)&message;
+    size_t left = sizeof(message);
+    while (left > 0) {
+        ssize_t n = read(fromServer, p, left);
+        if (n <= 0) break;
+        p += n;
+        left -= n;
+    }
+    return message;
+}
+
+static bool isError(const ProtocolMessage &message, int error) {
+    return message.type == MSG_ERROR && message.option == error;
+}
+
+static bool isOk(const ProtocolMessage &message, uint32_t game) {
+    return message.type == MSG_OK && message.game == game;
+}
+
+/*
+ * True if the engine's answer is a legal move for side, which is then
+ * played on board.
+ */
+static bool playAnswer(const ProtocolMessage &answer, Board *board,
+                       Side side) {
+    if (answer.type != MSG_BEST_MOVE || answer.square >= 64) return false;
+    if (((board->generateMoves(side) >> answer.square) & 1) == 0) {
+        return false;
+    }
+    board->makeMove(answer.square, side);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    int requests[2], replies[2];
+    if (pipe(requests) != 0 || pipe(replies) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    toServer = requests[1];
+    fromServer = replies[0];
+    thread server(serveStream, requests[0], replies[1]);
+
+    const uint32_t GAME = 7;
+    Board board;
+
+    ProtocolMessage hello = receive();
+    check(hello.type == MSG_HELLO && hello.value == PROTOCOL_VERSION,
+          "hello");
+
+    // The engine plays black, with a small table.
+    ProtocolMessage request;
+    memset(&request, 0, sizeof(request));
+    request.type = MSG_NEW_GAME;
+    request.game = GAME;
+    request.side = BLACK;
+    request.option = ALPHABETA_AI;
+    request.extra = 4;
+    if (write(toServer, &request, sizeof(request)) != sizeof(request)) {
+        perror("write");
+    }
+    check(isOk(receive(), GAME), "new game");
+    if (write(toServer, &request, sizeof(request)) != sizeof(request)) {
+        perror("write");
+    }
+    check(isError(receive(), PROTOCOL_GAME_EXISTS), "new game twice");
+
+    send(MSG_GO, GAME + 1, 0, 1000);
+    check(isError(receive(), PROTOCOL_NO_GAME), "go in an unknown game");
+    send(99, GAME);
+    check(isError(receive(), PROTOCOL_UNKNOWN_TYPE), "unknown request");
+
+    send(MSG_GO, GAME, 0, 2000);
+    check(playAnswer(receive(), &board, BLACK), "first move is legal");
+
+    // a1 is empty but flips nothing, d4 is taken, 65 is not a square.
+    send(MSG_MOVE, GAME, 0);
+    check(isError(receive(), PROTOCOL_BAD_MOVE), "move that flips nothing");
+    send(MSG_MOVE, GAME, 3 + 8 * 3);
+    check(isError(receive(), PROTOCOL_BAD_MOVE), "move to a taken square");
+    send(MSG_MOVE, GAME, PROTOCOL_PASS + 1);
+    check(isError(receive(), PROTOCOL_BAD_MOVE), "move off the board");
+    send(MSG_MOVE, GAME, PROTOCOL_PASS);
+    check(isError(receive(), PROTOCOL_BAD_MOVE), "pass with a move to make");
+
+    int reply = firstSquare(board.generateMoves(WHITE));
+    send(MSG_MOVE, GAME, reply);
+    check(isOk(receive(), GAME), "legal move");
+    board.makeMove(reply, WHITE);
+    send(MSG_MOVE, GAME, firstSquare(board.generateMoves(WHITE)));
+    check(isError(receive(), PROTOCOL_BAD_MOVE), "second move before go");
+
+    // An untimed go runs for UNTIMED_MOVE_MS unless it is stopped.
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    send(MSG_GO, GAME, 0, -1);
+    send(MSG_MOVE, GAME, PROTOCOL_PASS);
+    check(isError(receive(), PROTOCOL_BUSY), "move while searching");
+    send(MSG_STOP, GAME);
+    ProtocolMessage answer = receive();
+    int ms = chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now() - start).count();
+    check(playAnswer(answer, &board, BLACK), "stopped move is legal");
+    check(ms < UNTIMED_MOVE_MS, "stop cuts the move short");
+
+    memset(&request, 0, sizeof(request));
+    request.type = MSG_SET_POSITION;
+    request.game = GAME;
+    request.black = 1;
+    request.white = 1;
+    if (write(toServer, &request, sizeof(request)) != sizeof(request)) {
+        perror("write");
+    }
+    check(isError(receive(), PROTOCOL_BAD_MOVE), "overlapping position");
+
+    // White a1 and black b1-h1: white has no move, so it may pass.
+    request.black = 0xfe;
+    request.white = 0x01;
+    if (write(toServer, &request, sizeof(request)) != sizeof(request)) {
+        perror("write");
+    }
+    check(isOk(receive(), GAME), "set position");
+    send(MSG_MOVE, GAME, PROTOCOL_PASS);
+    check(isOk(receive(), GAME), "pass without a move to make");
+
+    send(MSG_END_GAME, GAME);
+    check(isOk(receive(), GAME), "end game");
+    send(MSG_GO, GAME, 0, 1000);
+    check(isError(receive(), PROTOCOL_NO_GAME), "go after end game");
+
+    // Closing the requests ends the session.
+    close(toServer);
+    server.join();
+    close(fromServer);
+
+    if (failures > 0) {
+        printf("%d protocol checks failed\n", failures);
+        return 1;
+    }
+    printf("All protocol checks passed\n");
+    return 0;
+}
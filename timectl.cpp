@@ -0,0 +1,190 @@
+#include "timectl.hpp"
+
+using namespace std;
+
+// A running iteration is abandoned at this multiple of the target.
+static const int MAXIMUM_FACTOR = 3;
+// No move may use more than this fraction of the time left.
+static const int MAXIMUM_SHARE = 3;
+// Each change of best move stretches the target by this much, up to
+// MAX_SCALE; a move that has held for STABLE_ITERATIONS shrinks it.
+static const double INSTABILITY_STEP = 0.5;
+static const double MAX_SCALE = 2.5;
+static const double STABLE_SCALE = 0.7;
+static const int STABLE_ITERATIONS = 4;
+// A score drop of this many evaluation units counts as instability too.
+static const int SCORE_DROP = 64;
+// Once a solve has been stopped, later ones get at most this many normal
+// move shares instead of a quarter of the clock.
+static const int EXACT_RETRY_SHARES = 1;
+
+/*
+ * The normal time for a move: the remaining time split over our remaining
+ * moves, weighted towards the midgame.
+ */
+static double moveShare(int msLeft, int empties) {
+    int movesLeft = (empties + 1) / 2;
+    double share = (double)msLeft / (movesLeft + 2);
+    if (empties > 44) share *= 0.75;
+    else if (empties > 20) share *= 1.25;
+    return share;
+}
+
+TimeControl::TimeControl() {
+    target = 0;
+    maximum = 0;
+    lastMove = -1;
+    lastScore = 0;
+    stableIterations = 0;
+    scale = 1;
+    exactStopped = false;
+    stopFlag = nullptr;
+    armed = false;
+    quit = false;
+    begin = chrono::steady_clock::now();
+    watchdog = thread(&TimeControl::watch, this);
+}
+
+TimeControl::~TimeControl() {
+    {
+        lock_guard<mutex> guard(lock);
+        quit = true;
+    }
+    wake.notify_one();
+    watchdog.join();
+}
+
+/*
+ * Begins timing a midgame move. The remaining time is split over our
+ * remaining moves, weighted towards the midgame: the opening is mostly
+ * shallow positions or book, and the exact solver needs little time for
+ * each of the last moves. msLeft == -1 means no limit.
+ */
+void TimeControl::start(int msLeft, int empties) {
+    begin = chrono::steady_clock::now();
+    lastMove = -1;
+    lastScore = 0;
+    stableIterations = 0;
+    scale = 1;
+
+    if (msLeft < 0) {
+        target = UNTIMED_MOVE_MS;
+        maximum = MAXIMUM_FACTOR * UNTIMED_MOVE_MS;
+    } else {
+        double share = moveShare(msLeft, empties);
+        int limit = msLeft / MAXIMUM_SHARE - SAFETY_MS;
+        target = (int)share - SAFETY_MS;
+        if (target > limit) target = limit;
+        if (target < 0) target = 0;
+        maximum = MAXIMUM_FACTOR * target;
+        if (maximum > limit) maximum = limit;
+        if (maximum < target) maximum = target;
+    }
+    arm();
+}
+
+/*
+ * Begins timing an exact solve, which gets a quarter of the time left: it
+ * either finishes the game's result or is abandoned for a midgame search.
+ * After a solve has been abandoned, a quarter each time would spend most
+ * of the clock on solves that don't finish, so the next ones only get
+ * EXACT_RETRY_SHARES normal move shares until one completes.
+ */
+void TimeControl::startExact(int msLeft, int empties) {
+    begin = chrono::steady_clock::now();
+    if (msLeft < 0) {
+        target = UNTIMED_ENDGAME_MS;
+    } else {
+        target = msLeft / 4 - SAFETY_MS;
+        if (exactStopped) {
+            int retry = (int)(EXACT_RETRY_SHARES * moveShare(msLeft, empties))
+                      - SAFETY_MS;
+            if (target > retry) target = retry;
+        }
+        if (target < 0) target = 0;
+    }
+    maximum = target;
+    arm();
+}
+
+/*
+ * Records whether the last solve finished, which sets the budget of the
+ * next one.
+ */
+void TimeControl::finishExact(bool stopped) {
+    exactStopped = stopped;
+    finish();
+}
+
+/*
+ * Ends the move; the watchdog goes back to sleep.
+ */
+void TimeControl::finish() {
+    lock_guard<mutex> guard(lock);
+    armed = false;
+}
+
+/*
+ * Called after each completed iteration with its best move and score;
+ * returns true if another iteration should be started. One that starts
+ * after half the (scaled) target is gone would rarely finish.
+ */
+bool TimeControl::nextIteration(int bestMove, int score) {
+    if (lastMove >= 0 && bestMove != lastMove) {
+        scale += INSTABILITY_STEP;
+        stableIterations = 0;
+    } else if (lastMove >= 0 && score < lastScore - SCORE_DROP) {
+        scale += INSTABILITY_STEP;
+        stableIterations = 0;
+    } else if (++stableIterations >= STABLE_ITERATIONS) {
+        scale = STABLE_SCALE;
+    }
+    if (scale > MAX_SCALE) scale = MAX_SCALE;
+    lastMove = bestMove;
+    lastScore = score;
+
+    double soft = target * scale;
+    if (soft > maximum) soft = maximum;
+    return elapsed() < soft / 2;
+}
+
+/*
+ * Milliseconds since the move began.
+ */
+int TimeControl::elapsed() const {
+    return chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now() - begin).count();
+}
+
+/*
+ * Lowers the stop flag and sets the watchdog to fire SAFETY_MS / 2 after
+ * the maximum, which stays inside the time held back from the budget.
+ */
+void TimeControl::arm() {
+    if (stopFlag == nullptr) return;
+    stopFlag->store(false);
+    {
+        lock_guard<mutex> guard(lock);
+        hardDeadline = begin + chrono::milliseconds(maximum + SAFETY_MS / 2);
+        armed = true;
+    }
+    wake.notify_one();
+}
+
+/*
+ * Watchdog thread: sleeps until the armed deadline passes, then raises the
+ * stop flag.
+ */
+void TimeControl::watch() {
+    unique_lock<mutex> guard(lock);
+    while (!quit) {
+        if (!armed) {
+            wake.wait(guard);
+        } else if (chrono::steady_clock::now() >= hardDeadline) {
+            stopFlag->store(true);
+            armed = false;
+        } else {
+            wake.wait_until(guard, hardDeadline);
+        }
+    }
+}
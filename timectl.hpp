@@ -0,0 +1,75 @@
+#ifndef __TIMECTL_H__
+#define __TIMECTL_H__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Per-move search time when the game is untimed (msLeft == -1).
+#define UNTIMED_MOVE_MS 1000
+// Exact-solve time limit when the game is untimed.
+#define UNTIMED_ENDGAME_MS 10000
+// Time held back from every budget for move output and process overhead.
+#define SAFETY_MS 50
+
+/*
+ * Decides how long each move may take. start() sets two limits from the
+ * clock and the game phase: a target the search normally stays under, and a
+ * maximum at which a running iteration is abandoned. Between iterations the
+ * search reports its best move, and the target grows while the move keeps
+ * changing and shrinks once it has settled.
+ *
+ * A watchdog thread raises the stop flag if a move is still running shortly
+ * after its maximum, whatever the engine is doing, so a move is always
+ * returned before the game clock runs out.
+ */
+class TimeControl {
+
+public:
+    TimeControl();
+    ~TimeControl();
+
+    void setStopFlag(std::atomic<bool> *flag) { this->stopFlag = flag; }
+    void start(int msLeft, int empties);
+    void startExact(int msLeft, int empties);
+    void finishExact(bool stopped);
+    void finish();
+
+    bool nextIteration(int bestMove, int score);
+    int elapsed() const;
+    int getTarget() const { return target; }
+    int getMaximum() const { return maximum; }
+    std::chrono::steady_clock::time_point getDeadline() const {
+        return begin + std::chrono::milliseconds(maximum);
+    }
+
+private:
+    void arm();
+    void watch();
+
+    std::chrono::steady_clock::time_point begin;
+    int target;
+    int maximum;
+
+    // Iteration history of the current move.
+    int lastMove;
+    int lastScore;
+    int stableIterations;
+    // Multiplies target; raised by instability, lowered by stability.
+    double scale;
+    // The last exact solve was stopped before it finished.
+    bool exactStopped;
+
+    // Raised when the watchdog fires; may be null, which disables it.
+    std::atomic<bool> *stopFlag;
+    std::thread watchdog;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::chrono::steady_clock::time_point hardDeadline;
+    bool armed;
+    bool quit;
+};
+
+#endif
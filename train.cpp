@@ -0,0 +1,234 @@
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "board.hpp"
+#include "eval.hpp"
+
+using namespace std;
+
+/*
+ * Fits the pattern evaluation weights to a corpus of positions with
+ * multi-threaded stochastic gradient descent, and writes a weight file that
+ * Player maps at startup.
+ *
+ * Each corpus line holds one position and the final result of its game:
+ *
+ *   <64 squares, row by row: 'b', 'w', anything else empty> <b|w> <score>
+ *
+ * where the letter is the side to move and score is black's final disc
+ * count minus white's. The corpus is streamed in chunks, so it can be much
+ * larger than memory; each chunk is split between the threads, which update
+ * the shared weights without locking.
+ */
+
+// Positions read and trained on at a time.
+static const size_t CHUNK_SIZE = 1 << 18;
+
+struct Sample {
+    EvalFeatures features;
+    int stage;
+    float target;
+};
+
+static const size_t NUM_WEIGHTS =
+    (size_t)EVAL_NUM_STAGES * EVAL_WEIGHTS_PER_STAGE;
+
+// Weights in evaluation units. Threads read and write them racily on
+// purpose; relaxed atomics keep that well defined without costing anything.
+static atomic<float> *weights;
+
+static int featureOffset[EVAL_NUM_FEATURES];
+
+/*
+ * Parses one corpus line; returns false if it is malformed.
+ */
+static bool parseSample(const char *line, Sample *sample) {
+    if (strlen(line) < 68 || line[64] != ' ' || line[66] != ' ') return false;
+
+    char data[64];
+    int empties = 0;
+    for (int i = 0; i < 64; i++) {
+        data[i] = (line[i] == 'b' || line[i] == 'w') ? line[i] : ' ';
+        if (data[i] == ' ') empties++;
+    }
+
+    Board board;
+    board.setBoard(data);
+    evalFeatures(board, &sample->features);
+    sample->stage = evalStage(empties);
+    sample->target = (float)(atof(line + 67) * EVAL_SCALE);
+    return true;
+}
+
+/*
+ * Reads up to CHUNK_SIZE samples; returns how many were read.
+ */
+static size_t readChunk(FILE *file, vector<Sample> &chunk, size_t *skipped) {
+    char line[256];
+    chunk.clear();
+    while (chunk.size() < CHUNK_SIZE && fgets(line, sizeof(line), file)) {
+        Sample sample;
+        if (parseSample(line, &sample)) {
+            chunk.push_back(sample);
+        } else {
+            (*skipped)++;
+        }
+    }
+    return chunk.size();
+}
+
+/*
+ * One SGD pass over samples [begin, end). Adds the squared error seen
+ * before each step to *error.
+ */
+static void trainSlice(const vector<Sample> *chunk, size_t begin, size_t end,
+                       float rate, double *error) {
+    double sum = 0;
+    for (size_t i = begin; i < end; i++) {
+        const Sample &sample = (*chunk)[i];
+        atomic<float> *w = weights + (size_t)sample.stage * EVAL_WEIGHTS_PER_STAGE;
+
+        float predicted = 0;
+        for (int f = 0; f < EVAL_NUM_FEATURES; f++) {
+            predicted += w[featureOffset[f] + sample.features.index[f]]
+                             .load(memory_order_relaxed);
+        }
+
+        float diff = sample.target - predicted;
+        sum += (double)diff * diff;
+
+        float step = rate * diff;
+        for (int f = 0; f < EVAL_NUM_FEATURES; f++) {
+            atomic<float> &entry = w[featureOffset[f] + sample.features.index[f]];
+            entry.store(entry.load(memory_order_relaxed) + step,
+                        memory_order_relaxed);
+        }
+    }
+    *error = sum;
+}
+
+/*
+ * Starts from the weights in an existing weight file.
+ */
+static bool loadInitial(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) return false;
+
+    EvalFileHeader header;
+    vector<int16_t> stored(NUM_WEIGHTS);
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, EVAL_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version >= 1 && header.version <= EVAL_FILE_VERSION &&
+              header.stages == EVAL_NUM_STAGES &&
+              header.weightsPerStage == EVAL_WEIGHTS_PER_STAGE &&
+              fread(stored.data(), sizeof(int16_t), NUM_WEIGHTS, file) ==
+                  NUM_WEIGHTS;
+    fclose(file);
+    if (!ok) return false;
+
+    for (size_t i = 0; i < NUM_WEIGHTS; i++) {
+        weights[i].store(stored[i], memory_order_relaxed);
+    }
+    return true;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s corpus [-o weights] [-e epochs] [-t threads] "
+                    "[-r rate] [-i initial-weights]\n", name);
+    exit(-1);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) usage(argv[0]);
+
+    const char *corpus = argv[1];
+    const char *output = EVAL_WEIGHTS_FILE;
+    const char *initial = nullptr;
+    int epochs = 10;
+    int threads = thread::hardware_concurrency();
+    float rate = 0.002f;
+
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 >= argc) usage(argv[0]);
+        if (!strcmp(argv[i], "-o")) output = argv[++i];
+        else if (!strcmp(argv[i], "-e")) epochs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-t")) threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r")) rate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-i")) initial = argv[++i];
+        else usage(argv[0]);
+    }
+    if (threads < 1) threads = 1;
+
+    evalInit();
+    for (int f = 0; f < EVAL_NUM_FEATURES; f++) {
+        featureOffset[f] = evalFeatureOffset(f);
+    }
+
+    weights = new atomic<float>[NUM_WEIGHTS];
+    for (size_t i = 0; i < NUM_WEIGHTS; i++) {
+        weights[i].store(0, memory_order_relaxed);
+    }
+    if (initial != nullptr && !loadInitial(initial)) {
+        fprintf(stderr, "can't read weights from %s\n", initial);
+        return 1;
+    }
+
+    vector<Sample> chunk;
+    chunk.reserve(CHUNK_SIZE);
+
+    for (int epoch = 0; epoch < epochs; epoch++) {
+        FILE *file = fopen(corpus, "r");
+        if (file == nullptr) {
+            fprintf(stderr, "can't open %s\n", corpus);
+            return 1;
+        }
+
+        size_t total = 0, skipped = 0;
+        double error = 0;
+        while (readChunk(file, chunk, &skipped) > 0) {
+            vector<thread> workers;
+            vector<double> errors(threads, 0);
+            size_t slice = (chunk.size() + threads - 1) / threads;
+            for (int t = 0; t < threads; t++) {
+                size_t begin = t * slice;
+                size_t end = min(chunk.size(), begin + slice);
+                if (begin >= end) break;
+                workers.push_back(thread(trainSlice, &chunk, begin, end, rate,
+                                         &errors[t]));
+            }
+            for (int t = 0; t < (int)workers.size(); t++) {
+                workers[t].join();
+                error += errors[t];
+            }
+            total += chunk.size();
+        }
+        fclose(file);
+
+        if (total == 0) {
+            fprintf(stderr, "no positions in %s\n", corpus);
+            return 1;
+        }
+        fprintf(stderr, "epoch %d: %zu positions, %zu skipped, "
+                        "rms error %.2f discs\n", epoch + 1, total, skipped,
+                sqrt(error / total) / EVAL_SCALE);
+        rate *= 0.8f;
+    }
+
+    vector<int16_t> rounded(NUM_WEIGHTS);
+    for (size_t i = 0; i < NUM_WEIGHTS; i++) {
+        float w = weights[i].load(memory_order_relaxed);
+        if (w > 32767) w = 32767;
+        if (w < -32767) w = -32767;
+        rounded[i] = (int16_t)lrintf(w);
+    }
+    if (!evalSave(output, rounded.data())) {
+        fprintf(stderr, "can't write %s\n", output);
+        return 1;
+    }
+    fprintf(stderr, "wrote %s\n", output);
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <new>
+#include "tt.hpp"
+
+using namespace std;
+
+static const int CACHE_LINE = 64;
+
+/*
+ * Layout of TTEntry::data, low bits first:
+ *   score 16 bits (two's complement), depth 8, bound 2, move 7, age 8.
+ */
+static uint64_t packData(int depth, int bound, int score, int move,
+                         uint8_t age) {
+    return (uint64_t)(uint16_t)score
+         | ((uint64_t)(uint8_t)depth << 16)
+         | ((uint64_t)bound << 24)
+         | ((uint64_t)move << 26)
+         | ((uint64_t)age << 33);
+}
+
+static void unpackData(uint64_t data, TTData *out) {
+    out->score = (int16_t)(data & 0xffff);
+    out->depth = (data >> 16) & 0xff;
+    out->bound = (data >> 24) & 0x3;
+    out->move = (data >> 26) & 0x7f;
+}
+
+static uint8_t dataAge(uint64_t data) {
+    return (data >> 33) & 0xff;
+}
+
+static int dataDepth(uint64_t data) {
+    return (data >> 16) & 0xff;
+}
+
+/*
+ * Allocates a table of at most the given size, rounded down to a power of
+ * two number of buckets, each aligned to a cache line.
+ */
+TranspositionTable::TranspositionTable(size_t megabytes) {
+    size_t bytes = megabytes * 1024 * 1024;
+    numBuckets = 1;
+    while (numBuckets * 2 * sizeof(TTBucket) <= bytes) {
+        numBuckets *= 2;
+    }
+
+    memory = new char[numBuckets * sizeof(TTBucket) + CACHE_LINE];
+    size_t offset = (CACHE_LINE - (uintptr_t)memory % CACHE_LINE) % CACHE_LINE;
+    buckets = new (memory + offset) TTBucket[numBuckets];
+    age = 0;
+    clear();
+}
+
+TranspositionTable::~TranspositionTable() {
+    delete[] memory;
+}
+
+/*
+ * Forgets every stored position.
+ */
+void TranspositionTable::clear() {
+    for (size_t b = 0; b < numBuckets; b++) {
+        for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+            buckets[b].entries[i].check.store(0, memory_order_relaxed);
+            buckets[b].entries[i].data.store(0, memory_order_relaxed);
+        }
+    }
+}
+
+/*
+ * Starts a new search generation. Entries keep working, but anything not
+ * touched since an earlier generation is the first to be replaced.
+ */
+void TranspositionTable::newSearch() {
+    age++;
+}
+
+/*
+ * Looks up a position; returns false if it isn't stored.
+ */
+bool TranspositionTable::probe(uint64_t key, TTData *out) {
+    TTBucket *bucket = &buckets[key & (numBuckets - 1)];
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        TTEntry *entry = &bucket->entries[i];
+        uint64_t data = entry->data.load(memory_order_relaxed);
+        uint64_t check = entry->check.load(memory_order_relaxed);
+        if (data != 0 && (check ^ data) == key) {
+            unpackData(data, out);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Stores a search result. The same position is updated in place, unless
+ * the stored result is deeper, from this generation and the new one isn't
+ * exact, in which case it is kept. Otherwise the entry replaced is the one
+ * from the oldest generation, and among those the shallowest.
+ */
+void TranspositionTable::store(uint64_t key, int depth, int bound, int score,
+                               int move) {
+    TTBucket *bucket = &buckets[key & (numBuckets - 1)];
+    TTEntry *replace = &bucket->entries[0];
+    int worst = 1 << 30;
+
+    for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+        TTEntry *entry = &bucket->entries[i];
+        uint64_t data = entry->data.load(memory_order_relaxed);
+        uint64_t check = entry->check.load(memory_order_relaxed);
+        bool same = (data != 0 && (check ^ data) == key);
+        if (same) {
+            TTData old;
+            unpackData(data, &old);
+            if (old.depth > depth && dataAge(data) == age &&
+                bound != BOUND_EXACT) {
+                return;
+            }
+            // Keep the old move if this result has none.
+            if (move == TT_NO_MOVE) move = old.move;
+            replace = entry;
+            break;
+        }
+        if (data == 0) {
+            replace = entry;
+            break;
+        }
+
+        int value = dataDepth(data) - 8 * (uint8_t)(age - dataAge(data));
+        if (value < worst) {
+            worst = value;
+            replace = entry;
+        }
+    }
+
+    uint64_t data = packData(depth, bound, score, move, age);
+    replace->check.store(key ^ data, memory_order_relaxed);
+    replace->data.store(data, memory_order_relaxed);
+}
@@ -0,0 +1,67 @@
+#ifndef __TT_H__
+#define __TT_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define DEFAULT_TT_MB 64
+
+// No best move recorded.
+static const int TT_NO_MOVE = 64;
+
+enum Bound {
+    BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT
+};
+
+/*
+ * What the table knows about a position.
+ */
+struct TTData {
+    int depth;
+    int bound;
+    int score;
+    int move;
+};
+
+/*
+ * One slot: the packed TTData, and the full position key xor'ed with it.
+ * Search threads read and write slots without locks; a slot torn by two
+ * concurrent writers fails the key check instead of returning mixed data.
+ */
+struct TTEntry {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data;
+};
+
+// Four 16-byte entries fill one 64-byte cache line, so a probe touches a
+// single line.
+#define TT_BUCKET_SIZE 4
+
+struct TTBucket {
+    TTEntry entries[TT_BUCKET_SIZE];
+};
+
+class TranspositionTable {
+
+public:
+    TranspositionTable(size_t megabytes);
+    ~TranspositionTable();
+
+    void clear();
+    void newSearch();
+    bool probe(uint64_t key, TTData *out);
+    void store(uint64_t key, int depth, int bound, int score, int move);
+
+    size_t getSize() { return numBuckets * TT_BUCKET_SIZE; }
+
+private:
+    char *memory;
+    TTBucket *buckets;
+    // Always a power of two, so a key maps to a bucket with a mask.
+    size_t numBuckets;
+    // Search generation, so entries from earlier moves are replaced first.
+    uint8_t age;
+};
+
+#endif
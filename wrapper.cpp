@@ -1,19 +1,122 @@
 #include <iostream>
+#include <csignal>
 #include <cstdlib>
 #include <cstring>
 #include "player.hpp"
+#include "server.hpp"
+#include "gamedb.hpp"
 using namespace std;
 
+static void usage(const char *name) {
+    cerr << "usage: " << name << " side [-t threads] [-p] [-q] "
+         << "[-l game-log] [-g game-file] [-k learn-file]" << endl
+         << "       " << name << " -b | -u socket-path" << endl;
+    exit(-1);
+}
+
+// Raised by SIGTERM, which the Java wrapper sends as soon as it has closed
+// our input at the end of a game.
+static volatile sig_atomic_t terminated = 0;
+
+static void onTerminate(int) {
+    terminated = 1;
+}
+
+/*
+ * Appends the game to the game file and saves what the player learned,
+ * once.
+ */
+static void finishGame(Player *player, const char *learnPath,
+                       GameWriter &gameFile, GameRecord &record,
+                       const Board &board, bool *finished) {
+    if (*finished) return;
+    *finished = true;
+    // A game that never started is not worth a record.
+    if (gameFile.isOpen() && record.numMoves > 0) {
+        gameFinish(&record, board, 0);
+        gameFile.append(record);
+    }
+    if (learnPath != nullptr && !player->saveLearned(learnPath)) {
+        cerr << "can't save learned results to " << learnPath << endl;
+    }
+}
+
 int main(int argc, char *argv[]) {
-    // Read in side the player is on.
-    if (argc != 2)  {
-        cerr << "usage: " << argv[0] << " side" << endl;
-        exit(-1);
+    // Read in side the player is on, then any options.
+    if (argc < 2)  {
+        usage(argv[0]);
+    }
+
+    // Binary protocol (server.hpp) instead of the text one: on stdin and
+    // stdout, or on a Unix socket.
+    if (!strcmp(argv[1], "-b")) {
+        return serveStream(0, 1);
+    }
+    if (!strcmp(argv[1], "-u")) {
+        if (argc < 3) usage(argv[0]);
+        return serveSocket(argv[2]);
     }
+
     Side side = (!strcmp(argv[1], "Black")) ? BLACK : WHITE;
 
+    int threads = 1;
+    bool ponder = false;
+    bool quiet = false;
+    const char *gameLog = nullptr;
+    const char *gamePath = nullptr;
+    const char *learnPath = nullptr;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-p")) {
+            // Think on the opponent's time.
+            ponder = true;
+        } else if (!strcmp(argv[i], "-q")) {
+            // No stats lines on stderr.
+            quiet = true;
+        } else if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+            gameLog = argv[++i];
+        } else if (!strcmp(argv[i], "-g") && i + 1 < argc) {
+            // Append the game to a game file when it ends. Only black
+            // records, so that a match whose players both get -g stores
+            // the game once.
+            gamePath = argv[++i];
+        } else if (!strcmp(argv[i], "-k") && i + 1 < argc) {
+            // Keep results from game to game in this file.
+            learnPath = argv[++i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+
     // Initialize player.
     Player *player = new Player(side);
+    player->setThreads(threads);
+    player->log_stats = !quiet;
+    if (gameLog != nullptr && !player->openGameLog(gameLog)) {
+        cerr << "can't write game log " << gameLog << endl;
+    }
+    if (learnPath != nullptr) player->loadLearned(learnPath);
+    GameWriter gameFile;
+    if (gamePath != nullptr && side == BLACK && !gameFile.open(gamePath)) {
+        cerr << "can't write games to " << gamePath << endl;
+    }
+
+    // The game so far, for the game file.
+    GameRecord record;
+    gameClear(&record);
+    Board board;
+    Side toMove = BLACK;
+    bool finished = false;
+
+    // A SIGTERM only ends the game, so that the record and the learned
+    // results are still written. It is installed without SA_RESTART, so a
+    // read waiting for the next move fails instead of resuming.
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onTerminate;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGTERM, &action, nullptr);
 
     // Tell java wrapper that we are done initializing.
     cout << "Init done" << endl;
@@ -22,15 +125,20 @@ int main(int argc, char *argv[]) {
     int moveX, moveY, msLeft;
 
     // Get opponent's move and time left for player each turn.
-    while (cin >> moveX >> moveY >> msLeft) {
+    while (!terminated && cin >> moveX >> moveY >> msLeft) {
+        Move theirMove(moveX, moveY);
         Move *opponentsMove = nullptr;
         if (moveX >= 0 && moveY >= 0) {
-            opponentsMove = new Move(moveX, moveY);
+            opponentsMove = &theirMove;
+            int sq = moveX + NUM_OTHELLO_SQUARES * moveY;
+            if (gamePlay(&board, &toMove, sq)) gamePush(&record, sq);
         }
 
         // Get player's move and output to java wrapper.
         Move *playersMove = player->doMove(opponentsMove, msLeft);
         if (playersMove != nullptr) {
+            int sq = playersMove->x + NUM_OTHELLO_SQUARES * playersMove->y;
+            if (gamePlay(&board, &toMove, sq)) gamePush(&record, sq);
             cout << playersMove->x << " " << playersMove->y << endl;
         } else {
             cout << "-1 -1" << endl;
@@ -38,10 +146,17 @@ int main(int argc, char *argv[]) {
         cout.flush();
         cerr.flush();
 
-        // Delete move objects.
-        if (opponentsMove != nullptr) delete opponentsMove;
-        if (playersMove != nullptr) delete playersMove;
+        // Our move may have ended the game, and we won't hear back.
+        if (board.isDone()) {
+            finishGame(player, learnPath, gameFile, record, board, &finished);
+        }
+
+        if (ponder) player->startPondering();
     }
 
+    // The opponent's last moves never reach us if they end the game, so
+    // the record may stop short of the end and is then marked unfinished.
+    // This also runs after a SIGTERM.
+    finishGame(player, learnPath, gameFile, record, board, &finished);
     return 0;
 }